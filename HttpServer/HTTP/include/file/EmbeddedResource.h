@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+namespace http
+{
+namespace file
+{
+// 编译进程序的一个资源文件，由cmake/EmbedResources.cmake在构建时生成
+// 响应头和内容都预先拼好，直接作为HttpResponse::setPreformatted的字节使用
+struct EmbeddedResource
+{
+    std::string_view name; // 相对资源目录的路径
+    std::string_view contentType;
+    std::string_view etag; // 带引号
+    std::string_view plain; // 响应头 + 空行 + 原始内容
+    std::string_view gzip; // 响应头 + 空行 + gzip压缩的内容，不可压缩时为空
+    std::string_view notModified; // 304使用的响应头
+    std::string_view gzipEtag; // gzip版本的ETag，带引号，没有gzip版本时为空
+    std::string_view gzipNotModified; // 匹配gzip版本的ETag时304使用的响应头
+};
+
+struct EmbeddedResourceTable
+{
+    const EmbeddedResource* resources;
+    size_t count;
+};
+
+} // namespace file
+} // namespace http
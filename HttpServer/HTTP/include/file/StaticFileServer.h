@@ -0,0 +1,96 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include <muduo/base/noncopyable.h>
+#include <muduo/net/Channel.h>
+#include <muduo/net/EventLoop.h>
+
+#include "EmbeddedResource.h"
+#include "../http/HttpRequest.h"
+#include "../http/HttpResponse.h"
+
+namespace http
+{
+namespace file
+{
+// 静态文件服务：root目录下的文件在启动时全部读入内存，请求时不访问磁盘
+// 每个文件预先生成好响应头和响应体（Content-Type、Content-Length、ETag），
+// 可压缩的类型另外生成一份gzip版本，客户端支持时使用
+// 文件变化通过inotify感知，只重新加载变化的那个文件
+// 也可以使用构建时编译进程序的资源（见EmbeddedResource.h），这时完全不访问文件系统，响应直接引用程序中的字节
+class StaticFileServer : muduo::noncopyable
+{
+public:
+    static const size_t kMaxFileSize = 16 * 1024 * 1024; // 超过这个大小的文件不缓存
+
+    // urlPrefix: 映射到root的URL前缀，例如"/static"；只使用编译进程序的资源时root为空
+    StaticFileServer(const std::string& root, const std::string& urlPrefix);
+    ~StaticFileServer();
+
+    // 读入root下的所有文件，返回文件个数
+    size_t load();
+    // 加入编译进程序的资源，在load之后调用，和root下的同名文件冲突时以root下的为准，返回资源个数
+    size_t loadEmbedded(const EmbeddedResourceTable& table);
+    // 在loop中监听root下文件的变化，需要在loop所在的线程调用
+    void watch(muduo::net::EventLoop* loop);
+
+    // 按相对root的路径（不以/开头）写入响应，文件不存在时返回false
+    // 请求的If-None-Match和缓存的ETag（原始版本或gzip版本的）一致时返回304
+    bool serveFile(const std::string& name, const HttpRequest& req, HttpResponse* resp) const;
+
+    // 文件的原始内容（不含响应头），返回持有这段内存的对象，文件不存在时返回空
+    // 文件重新加载后返回的是另一个对象，可以据此判断内容是否变化
+    std::shared_ptr<const void> content(const std::string& name, std::string_view* body) const;
+
+    const std::string& root() const { return root_; }
+    const std::string& urlPrefix() const { return urlPrefix_; }
+    size_t fileCount() const;
+
+    static const char* contentType(const std::string& name);
+
+private:
+    // 一个文件的缓存，生成后不再修改，请求中直接引用其中的字节
+    // 从磁盘读入的文件字节存在storage里，编译进程序的资源直接指向静态存储
+    struct Entry
+    {
+        std::string_view etag;
+        std::string_view plain; // 响应头 + 空行 + 原始内容
+        std::string_view gzip; // 响应头 + 空行 + gzip压缩的内容，不可压缩时为空
+        std::string_view notModified; // 304使用的响应头
+        std::string_view gzipEtag; // gzip版本的ETag，带引号，没有gzip版本时为空
+        std::string_view gzipNotModified; // 匹配gzip版本的ETag时304使用的响应头
+        std::string_view body; // plain中的原始内容
+        std::string storage[6];
+    };
+    using FileMap = std::unordered_map<std::string, std::shared_ptr<const Entry>>;
+
+    static std::shared_ptr<const Entry> buildEntry(const std::string& name, const std::string& content);
+    // 读取目录下的所有文件（递归），dir为相对root的路径
+    void scanDir(const std::string& dir, FileMap& files);
+    bool readFile(const std::string& name, std::string& content) const;
+
+    // 复制一份文件表，修改后原子地替换，请求线程拿到的旧表和其中的Entry仍然有效
+    void reloadFile(const std::string& name);
+    void removeFile(const std::string& name);
+    void addWatch(const std::string& dir);
+    void handleEvents();
+
+    std::shared_ptr<const FileMap> files() const;
+    void setFiles(std::shared_ptr<const FileMap> files);
+
+private:
+    const std::string root_;
+    const std::string urlPrefix_;
+    std::shared_ptr<const FileMap> files_; // 用std::atomic_load/atomic_store访问
+
+    // inotify，只在监听的loop线程中使用，root为空时不监听
+    int inotifyFd_;
+    std::unique_ptr<muduo::net::Channel> inotifyChannel_;
+    std::unordered_map<int, std::string> watches_; // watch描述符 -> 相对root的目录
+};
+
+} // namespace file
+} // namespace http
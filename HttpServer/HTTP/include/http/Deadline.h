@@ -0,0 +1,91 @@
+#pragma once
+
+#include <stdexcept>
+#include <muduo/base/Timestamp.h>
+
+namespace http
+{
+// 请求超过截止时间后，各处取消工作时抛出的异常
+class DeadlineExceeded : public std::runtime_error
+{
+public:
+    DeadlineExceeded() : std::runtime_error("request deadline exceeded") {}
+};
+
+// 当前线程正在处理的请求的截止时间
+// 请求的每一步都在一个线程中同步执行，所以用线程局部变量传递，数据库连接池、AI搜索等不需要额外的参数
+// 异步处理交给别的线程时，在那个线程里用请求的截止时间再建一个Scope
+class Deadline
+{
+public:
+    // 在处理一个请求期间设置截止时间，析构时恢复
+    class Scope
+    {
+    public:
+        explicit Scope(muduo::Timestamp deadline) : saved_(state())
+        {
+            state().deadline = deadline;
+            state().exceeded = false;
+        }
+        ~Scope() { state() = saved_; }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+        // 处理过程中是否有环节因为超时被取消
+        bool exceeded() const { return state().exceeded; }
+
+    private:
+        struct State
+        {
+            muduo::Timestamp deadline;
+            bool exceeded = false;
+        };
+        friend class Deadline;
+        static State& state()
+        {
+            static thread_local State current;
+            return current;
+        }
+        State saved_;
+    };
+
+    // 当前截止时间，没有设置时为invalid
+    static muduo::Timestamp current() { return Scope::state().deadline; }
+
+    static bool expired()
+    {
+        muduo::Timestamp deadline = current();
+        return deadline.valid() && !(muduo::Timestamp::now() < deadline);
+    }
+
+    // 剩余的秒数，没有设置截止时间时返回-1
+    static double remaining()
+    {
+        muduo::Timestamp deadline = current();
+        if (!deadline.valid())
+        {
+            return -1;
+        }
+        double left = muduo::timeDifference(deadline, muduo::Timestamp::now());
+        return left > 0 ? left : 0;
+    }
+
+    // 当前请求是否已经被标记为超时
+    static bool exceeded() { return Scope::state().exceeded; }
+
+    // 标记当前请求已超时（用于不抛异常、自行退出的地方）
+    static void markExceeded() { Scope::state().exceeded = true; }
+
+    // 超时则标记并抛出DeadlineExceeded
+    static void check()
+    {
+        if (expired())
+        {
+            markExceeded();
+            throw DeadlineExceeded();
+        }
+    }
+};
+
+} // namespace http
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+
+#include <muduo/base/noncopyable.h>
+
+namespace http
+{
+// 热升级：新旧进程通过Unix域套接字交接监听套接字（SCM_RIGHTS）
+// 旧进程：在控制套接字上等待新进程，收到升级请求后把监听fd发过去，收到新进程就绪的确认后停止accept并排空连接
+// 新进程：连接控制套接字发送升级请求，取得监听fd，替换掉服务器自己创建的套接字，开始监听后通知旧进程
+// 注意：新旧进程都需要以kReusePort方式创建TcpServer，否则新进程的服务器在构造时bind会失败；
+// 也正因为如此，只有需要热升级的进程才应该开启kReusePort，否则误启动的第二个实例会悄悄分走一半连接
+class HotUpgrade : muduo::noncopyable
+{
+public:
+    using HandoffCallback = std::function<void()>;
+
+    HotUpgrade(const std::string& controlPath, uint16_t port);
+    ~HotUpgrade();
+
+    // 新进程：在TcpServer::start()之前调用，从旧进程取得监听套接字并接管
+    // 没有旧进程在运行时返回false，此时照常使用自己的套接字
+    bool takeOver();
+    // 新进程：已经开始监听，通知旧进程可以停止accept了
+    void notifyReady();
+    // 控制套接字上是否已经有进程在等待升级（即同一个端口上已经有服务器在运行）
+    // 只是连接一下，不会触发交接
+    bool running() const;
+    const std::string& controlPath() const { return controlPath_; }
+
+    // 旧进程（以及接管完成后的新进程）：在后台线程等待下一次升级
+    // 交接完成后在后台线程中调用cb；控制套接字已经被别的进程（不是刚接管的旧进程）占用时不会替换它
+    void listen(const HandoffCallback& cb);
+    bool handedOver() const { return handedOver_.load(); }
+
+private:
+    void acceptThreadFunc();
+    // 在本进程的fd中找绑定在port_上的TCP套接字，listening指定要找的是否已处于监听状态
+    int findSocket(bool listening) const;
+
+    static bool sendFd(int sock, int fd);
+    static int recvFd(int sock);
+
+private:
+    std::string controlPath_; // 控制套接字路径
+    uint16_t port_;
+    int controlFd_; // 新进程：与旧进程之间的连接
+    bool tookOver_; // 从旧进程接管了监听套接字，旧进程的控制套接字随后会关闭，可以直接替换
+    // 旧进程：控制套接字上的监听fd，后台线程交接完成时和析构时都会关闭，谁先换成-1谁负责关闭
+    std::atomic<int> listenFd_;
+    HandoffCallback handoffCallback_;
+    std::atomic<bool> handedOver_{false};
+    std::thread acceptThread_;
+};
+
+} // namespace http
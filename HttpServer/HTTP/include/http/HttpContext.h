@@ -20,6 +20,12 @@ public:
 
     bool parseRequest(muduo::net::Buffer* buf, muduo::Timestamp receiveTime);
     bool gotAll() const { return state_ == kGotAll; }
+    // 没有解析到一半的请求，也没有在处理中的请求
+    bool idle() const { return state_ == kExpectRequestLine && !pending_; }
+
+    // 上一个请求还在（异步）处理中，响应发出之前不解析后面的请求，保证响应的顺序
+    bool pending() const { return pending_; }
+    void setPending(bool pending) { pending_ = pending; }
 
     void reset() 
     {
@@ -34,7 +40,14 @@ public:
     HttpRequest& request() { return request_; }
 
 
-    HttpContext() : state_(kExpectRequestLine) {}
+    // requestTimeout: 每个请求从接收到处理完成的最长时间（秒）
+    explicit HttpContext(double requestTimeout = kDefaultRequestTimeout)
+        : state_(kExpectRequestLine), pending_(false), requestTimeout_(requestTimeout) {}
+
+    static constexpr double kDefaultRequestTimeout = 10.0;
+
+    // 连接的对端地址，每个请求都会带上
+    void setRemoteAddr(const std::string& addr) { remoteAddr_ = addr; }
 
 private:
     // 处理请求行这个方法是在解析请求中调用的
@@ -42,6 +55,9 @@ private:
 
 private:
     HttpRequestParseState state_;
+    bool pending_;
+    double requestTimeout_;
+    std::string remoteAddr_;
     HttpRequest request_;
 };
 
@@ -1,12 +1,21 @@
 #pragma once
 
+#include <array>
+#include <cstdint>
 #include <map>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <muduo/base/Timestamp.h>
 
 namespace http
 {
+namespace session
+{
+class Session;
+}
+
 class HttpRequest
 {
 public:
@@ -23,11 +32,21 @@ public:
 
     };
 
+    // 路由匹配得到的命名参数，值用在path_中的偏移表示，请求对象被拷贝后仍然有效
+    struct PathParam
+    {
+        std::string_view name; // 指向路由表中保存的参数名
+        uint32_t offset;
+        uint32_t length;
+    };
+    static const int kMaxPathParams = 8;
+
     HttpRequest() : method_(kInvalid), version_("Unknow") {}
 
     // 核心方法
     bool setMethod(const char* start, const char* end); // 传入的应该是用户缓存的某一段地址的起点和终点
     Method method() const { return method_; }
+    const char* methodString() const; // 方法名，用于日志
 
     void addHeader(const char* start, const char* colon, const char* end); // colon指向请求头中冒号所在位置的指针
     std::string getHeader(const std::string& field) const;
@@ -47,18 +66,42 @@ public:
     uint64_t ContentLength() const { return contentLength_; }
 
     void setPath(const char* start, const char* end);
-    std::string path() const { return path_; }
+    const std::string& path() const { return path_; }
 
     // 其他方法
     void setReceiveTime(muduo::Timestamp t);
     muduo::Timestamp receiveTime() const { return receiveTime_; }
 
+    // 截止时间，解析请求时根据接收时间设置，超过后处理会被取消并返回504
+    void setDeadline(muduo::Timestamp deadline) { deadline_ = deadline; }
+    muduo::Timestamp deadline() const { return deadline_; }
+
+    // 调用链追踪的id，请求没有被采样时为0
+    void setTraceId(uint64_t traceId) { traceId_ = traceId; }
+    uint64_t traceId() const { return traceId_; }
+
     void setPathParameters(const std::string& key, const std::string& value);
     std::string getPathParameters(const std::string& key) const;
 
+    // 由路由器在匹配成功后写入，不分配内存
+    bool addPathParameter(std::string_view name, size_t offset, size_t length);
+    void clearPathParameters() { pathParamCount_ = 0; }
+    // 按名字或位置取路由参数，返回指向path_的视图，不存在时为空
+    std::string_view pathParameter(std::string_view name) const;
+    std::string_view pathParameter(int index) const;
+    int pathParameterCount() const { return pathParamCount_; }
+
     void setQueryPathParameters(const char* start, const char* value);
     std::string getQueryParameters(const std::string &key) const;
 
+    // 客户端地址（IP），由HttpContext在解析请求时设置
+    void setRemoteAddr(const std::string& addr) { remoteAddr_ = addr; }
+    const std::string& remoteAddr() const { return remoteAddr_; }
+
+    // 本次请求使用的会话，由SessionManager::getSession记录，处理完成后由服务器统一提交修改
+    void setSession(std::shared_ptr<session::Session> session) const { session_ = std::move(session); }
+    const std::shared_ptr<session::Session>& session() const { return session_; }
+
     void setVersion(std::string version) { version_ = version;}
     std::string getVersion() const { return version_; }
 
@@ -74,6 +117,8 @@ private:
     
     std::string path_; // URL
     std::unordered_map<std::string, std::string> pathParameters_;// 路径参数，用来支持动态路由
+    std::array<PathParam, kMaxPathParams> pathParams_; // 路由匹配得到的参数，内联存储
+    int pathParamCount_ {0};
     // 利用这些参数来确定执行某一个特定的回调函数
     std::unordered_map<std::string, std::string> queryParameters_; // URL查询参数
 
@@ -85,6 +130,10 @@ private:
     std::string content_;// 请求体的内容
 
     muduo::Timestamp receiveTime_;// 接收时间，用了muduo的时间戳模块，可以计算时间差，比较时间点
+    muduo::Timestamp deadline_; // 截止时间
+    uint64_t traceId_ {0}; // 调用链追踪的id
+    std::string remoteAddr_; // 客户端IP
+    mutable std::shared_ptr<session::Session> session_; // 处理器拿到的是const请求，会话在处理中才确定
 
 };
 
@@ -1,6 +1,9 @@
 #pragma once
 
 #include <map>
+#include <memory>
+#include <string>
+#include <string_view>
 #include <muduo/net/TcpServer.h>
 
 namespace http
@@ -16,14 +19,16 @@ public:
         k204NoContent = 204, // 请求成功，但是服务器没有返回任何数据
         k301MovedPermanently = 301, // 资源永久重定向到新位置
         // k302 = 302, // 资源临时重定向到新位置
-        // k304 = 304, // 自上一次请求后，该资源没有被修改，重定向到缓存查找
+        k304NotModified = 304, // 自上一次请求后，该资源没有被修改，重定向到缓存查找
         k400BadRequest = 400, // 请求无效
         k401Unauthorized = 401, // 请求需要身份验证
         k403Forbidden = 403, // 请求的资源被禁止访问
         k404NotFound = 404, // 请求的资源不存在
         k409Conflict = 409,
+        k429TooManyRequests = 429, // 请求过于频繁，被限流
         // k503 = 503, // 服务器不存在
-        k500InternalServerError = 500 // 服务器内部错误
+        k500InternalServerError = 500, // 服务器内部错误
+        k504GatewayTimeout = 504 // 请求处理超过了截止时间
     };
 
     HttpResponse(bool close = true) :  statusCode_(kUnknow), closeConnection_(close) {}
@@ -36,6 +41,7 @@ public:
     HttpStatusCode getStatusCode() const { return statusCode_;}
 
     void setStatusMessage(const std::string Message) {statusMessage_ = Message;}
+    const std::string& statusMessage() const { return statusMessage_; }
 
     // 关闭连接
     void setCloseConnection(bool on) { closeConnection_ = on; }
@@ -45,14 +51,43 @@ public:
     void setContentLength(uint64_t length) { addHeader("Content-Length", std::to_string(length));}
     void setContentType(const std::string& contentType) { addHeader("Content-Type", contentType);}
     void addHeader(const std::string& key, const std::string& value) {headers_[key] = value;}
+    bool hasHeader(const std::string& key) const { return headers_.count(key) > 0; }
+    // 追加已经格式化好的响应头（每行以\r\n结尾），用于中间件预先生成的固定头部，不经过map
+    void appendRawHeaders(const std::string& block) { rawHeaders_.append(block); }
 
     // 响应体
     void setBody(const std::string& body) { body_ = body;}
+    void setBody(std::string&& body) { body_ = std::move(body);}
     
     // 这个上面个拆解开来了
     void setStatusLine(HttpStatusCode statusCode, const std::string& statusMessage, const std::string& version);
     void setErrorHeader() {}
+    // 丢弃已经写入的内容，改成504超时响应并关闭连接
+    void setGatewayTimeout(const std::string& version);
     
+    // 使用预先序列化好的响应头和响应体（不含状态行和Connection，以空行分隔头部和响应体）
+    // 输出时状态行、Connection以及addHeader/appendRawHeaders添加的头部仍然照常生成，写在它前面，
+    // 这样限流、缓存等中间件可以复用同一份字节，只需设置状态行
+    void setPreformatted(std::shared_ptr<const std::string> headersAndBody)
+    {
+        preformatted_ = *headersAndBody;
+        preformattedOwner_ = std::move(headersAndBody);
+    }
+    // 字节由owner持有，响应发出之前owner一直有效；owner为空时字节必须是静态存储（如编译进程序的资源）
+    void setPreformatted(std::string_view headersAndBody, std::shared_ptr<const void> owner)
+    {
+        preformatted_ = headersAndBody;
+        preformattedOwner_ = std::move(owner);
+    }
+    void clearPreformatted()
+    {
+        preformatted_ = std::string_view();
+        preformattedOwner_.reset();
+    }
+    bool preformatted() const { return !preformatted_.empty(); }
+    // 把当前的响应头（Connection除外）和响应体序列化成setPreformatted使用的格式
+    std::string formatHeadersAndBody() const;
+
     // 添加到用户缓存区Buffer 然后send(),写到socketfd上
     void appendToBuffer(muduo::net::Buffer* outputBuf) const;
 
@@ -66,8 +101,9 @@ public:
         {
             length += header.first.size() + 1 + header.second.size() + 1;
         }
+        length += rawHeaders_.size();
         // 响应体
-        length += body_.size();
+        length += preformatted() ? preformatted_.size() : body_.size();
         return length;
     }
 private:
@@ -78,10 +114,13 @@ private:
 
     // 响应头
     std::map<std::string, std::string> headers_;
+    std::string rawHeaders_; // 预先格式化好的响应头
     // 响应体
     std::string body_;
     
     bool closeConnection_;
+    std::string_view preformatted_; // 预先序列化好的响应头和响应体
+    std::shared_ptr<const void> preformattedOwner_; // 保证preformatted_指向的字节有效
 
     bool isFile_;
 };
@@ -6,11 +6,14 @@
 #include <unistd.h>
 // 这个就是POSIX操作系统的一些系统调用，读写，close，fork等
 
+#include <atomic>
 #include <functional>
 #include <iostream>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <unordered_map>
+#include <vector>
 
 #include <muduo/net/EventLoop.h>
 #include <muduo/base/Logging.h> // 日志系统
@@ -20,8 +23,21 @@
 #include "../ssl/SslContext.h"
 #include "../middlerWare/cors/CorsMiddleware.h"
 #include "../middlerWare/MiddlewareChain.h"
+#include "../middlerWare/MiddlewareGroups.h"
+#include "../middlerWare/ratelimit/RateLimitMiddleware.h"
+#include "../middlerWare/cache/ResponseCacheMiddleware.h"
 #include "../session/SessionManager.h"
+#include "../session/PersistentSessionStorage.h"
+#include "../session/CookieSessionStorage.h"
+#include "../session/ShmSessionStorage.h"
 #include "../router/Router.h"
+#include "../file/StaticFileServer.h"
+#include "../log/AccessLogger.h"
+#include "../utils/CpuAffinity.h"
+#include "../trace/Tracer.h"
+#include "Deadline.h"
+#include "HotUpgrade.h"
+#include "LoadAwareTcpServer.h"
 #include "HttpContext.h"
 #include "HttpResponse.h"
 #include "HttpRequest.h"
@@ -32,6 +48,8 @@ class HttpServer : muduo::noncopyable
 {
 public:
     using HttpCallback = std::function<void(const HttpRequest& , HttpResponse*)>;
+    // 服务器级别的请求回调，请求归连接的HttpContext所有，以可变引用一路传给中间件和路由，不做拷贝
+    using RequestCallback = std::function<void(HttpRequest&, HttpResponse*)>;
 
     HttpServer(int port,
                const std::string& name,
@@ -45,12 +63,18 @@ public:
         server_.setThreadNum(numThreads);
     }
 
+    // 每个请求从接收到处理完成的最长时间（秒），超过后取消处理并返回504
+    void setRequestTimeout(double seconds) { requestTimeout_ = seconds; }
+
+    // 主循环和各IO线程绑核，需要在start()之前调用
+    void setCpuAffinity(const CpuAffinityConfig& config);
+
     muduo::net::EventLoop* getLoop() const
     {
         return server_.getLoop();
     }
 
-    void setHttpCallback(HttpCallback& cb)
+    void setHttpCallback(const RequestCallback& cb)
     {
         httpCallback_ = cb;// 这不应该根据路由的结果来决定么
     }
@@ -72,19 +96,33 @@ public:
         router_.registerHandler(HttpRequest::kPost, path, handler);
     }
 
+    // 使用编译期生成的静态路由表，需要在Get/Post之前调用
+    template <size_t N>
+    void useStaticRoutes(const router::StaticRouteTable<N>& table)
+    {
+        router_.useStaticTable(table);
+    }
+
     // void addStaticRoute(HttpRequest::Method method, const std::string& path, const HttpCallback& cb)
     // {
     //     router_.registerCallBack(method, path, cb);
     // } 
 
     // 处理动态路由
+    // 把root目录下的文件映射到 urlPrefix/相对路径 上（GET），文件在这里全部读入内存，
+    // 服务器启动后在主循环中通过inotify监听变化；返回的对象也可以在处理器中按文件名直接使用
+    std::shared_ptr<file::StaticFileServer> serveStatic(const std::string& urlPrefix, const std::string& root);
+    // 同上，文件来自构建时编译进程序的资源，不访问文件系统
+    std::shared_ptr<file::StaticFileServer> serveEmbedded(const std::string& urlPrefix,
+                                                          const file::EmbeddedResourceTable& table);
+
     void addRoute(HttpRequest::Method method, const std::string& path, const HttpCallback& cb)
     {
-        router_.addRegexCallback(method, path, cb);
+        router_.addDynamicCallback(method, path, cb);
     }
     void addRoute(HttpRequest::Method method, const std::string& path, router::Router::HandlerPtr handler)
     {
-        router_.addRegexHandler(method, path, handler);
+        router_.addDynamicHandler(method, path, handler);
     }
 
     // 设置会话管理器
@@ -98,10 +136,20 @@ public:
         return sessionManager_.get();
     }
 
-    // 添加中间链
+    // 添加中间链，对所有请求生效
     void addMiddleware(std::shared_ptr<middleware::Middleware> middleware)
     {
-        middlewareChain_.addMiddleware(middleware);
+        middlewares_.addGlobal(middleware);
+    }
+    // 只对路径以prefix开头的一组路由生效
+    void addMiddleware(const std::string& prefix, std::shared_ptr<middleware::Middleware> middleware)
+    {
+        middlewares_.addToGroup(prefix, middleware);
+    }
+    // 只对prefix开头的路由生效，并且在全局中间件之前执行，全局中间件拒绝的请求也会经过它的after
+    void addOuterMiddleware(const std::string& prefix, std::shared_ptr<middleware::Middleware> middleware)
+    {
+        middlewares_.addOuterToGroup(prefix, middleware);
     }
 
     void enableSSL(bool enable)
@@ -109,6 +157,13 @@ public:
         useSsl_ = enable;
     }
     void setSslConfig(const ssl::SslConfig& config);
+
+    // 开启热升级：controlPath为新旧进程交接监听套接字用的Unix域套接字路径
+    // takeOver为true时从正在运行的旧进程接管监听套接字
+    // drainTimeout为交接后旧进程等待在途请求完成的最长时间（秒）
+    // 需要以TcpServer::kReusePort方式构造HttpServer；不需要热升级时不要开启kReusePort
+    // takeOver为false而控制套接字上已经有服务器在运行时，start()会拒绝启动
+    void enableHotUpgrade(const std::string& controlPath, bool takeOver, double drainTimeout = 30.0);
     
 private:
     void initialize();// 初始化httpserver
@@ -116,29 +171,64 @@ private:
     void onConnection(const muduo::net::TcpConnectionPtr& conn);
     // 收到连接数据执行回调-》封装request对象
     void onMessage(const muduo::net::TcpConnectionPtr& conn, muduo::net::Buffer* buf, muduo::Timestamp receieveTime);
+    // 依次解析buf中的请求并处理，上一个请求还在异步处理时停下，等它的响应发出后再继续
+    void processBuffer(const muduo::net::TcpConnectionPtr& conn, muduo::net::Buffer* buf, muduo::Timestamp receiveTime);
     // 收到请求request执行回调-》封装response
-    void onRequest(const muduo::net::TcpConnectionPtr& conn, const HttpRequest& req);
+    void onRequest(const muduo::net::TcpConnectionPtr& conn, HttpContext* context);
+
+    // 一个正在处理的请求，中间件或处理器异步执行时会跨越多次事件循环
+    struct Exchange;
+    using ExchangePtr = std::shared_ptr<Exchange>;
+
+    void handleRequest(const ExchangePtr& ex);
+    // 在请求所在的IO线程中执行一步处理：恢复截止时间，超时和异常直接结束请求
+    void runStep(const ExchangePtr& ex, const std::function<void()>& step);
+    // 处理完成：发送响应，然后继续解析处理期间到达的请求
+    void finishRequest(const ExchangePtr& ex);
+    void sendResponse(const muduo::net::TcpConnectionPtr& conn, const HttpRequest& req, HttpResponse& response);
+    // 连接上待解析的数据所在的缓冲区，HTTPS连接是解密后的缓冲区
+    muduo::net::Buffer* requestBuffer(const muduo::net::TcpConnectionPtr& conn);
+
+    // 注册 urlPrefix/*path 路由
+    void mountStatic(const std::shared_ptr<file::StaticFileServer>& files);
 
-    void handleRequest(const HttpRequest& req, HttpResponse* resp);
+    // 监听套接字交给新进程后，关闭空闲连接并等待在途请求完成
+    void drain();
 
     
 private:
     ssl::SslConfig sslConfig_;
     muduo::net::InetAddress listenAddr_;// 监听地址
-    muduo::net::TcpServer server_;// 处理socketfd，监听、执行回调创建conn对象、分发连接
-    muduo::net::EventLoop mainLoop_;// 事件循环
+    muduo::net::EventLoop mainLoop_;// 事件循环，必须在server_之前构造
+    LoadAwareTcpServer server_;// 处理socketfd，监听、执行回调创建conn对象、按负载分发连接
 
-    HttpCallback httpCallback_; //回调
+    RequestCallback httpCallback_; // 用户设置的同步回调，设置后代替中间件和路由处理所有请求
 
     router::Router router_;// 路由
 
     std::unique_ptr<session::SessionManager> sessionManager_; // 会话管理
 
-    middleware::MiddlewareChain middlewareChain_;
+    middleware::MiddlewareGroups middlewares_; // 启动时按路由分组生成固定的中间件链
+
+    std::vector<std::shared_ptr<file::StaticFileServer>> staticFiles_; // 静态文件，先于mainLoop_析构
 
     std::unique_ptr<ssl::SslContext> sslCtx_; // ssl上下问对象
     bool                             useSsl_;
     // 管理所有HTTPS连接
     std::map<muduo::net::TcpConnectionPtr, std::unique_ptr<ssl::SslConnection>> sslConns_;
+
+    double                           requestTimeout_ = HttpContext::kDefaultRequestTimeout;
+
+    CpuAffinityConfig                cpuAffinity_;
+    std::atomic<int>                 nextIoLoop_{0}; // 下一个启动的IO线程的序号
+
+    // 热升级
+    std::unique_ptr<HotUpgrade>      upgrade_;
+    bool                             takeOver_ = false;
+    double                           drainTimeout_ = 30.0;
+    std::atomic<bool>                draining_{false}; // 正在排空，不再复用连接
+    std::atomic<int>                 activeConns_{0};
+    std::mutex                       connsMutex_; // 保护liveConns_，onConnection在各个IO线程中执行
+    std::unordered_map<std::string, std::weak_ptr<muduo::net::TcpConnection>> liveConns_;
 };
 }
\ No newline at end of file
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <muduo/base/noncopyable.h>
+#include <muduo/net/Channel.h>
+#include <muduo/net/EventLoop.h>
+#include <muduo/net/EventLoopThreadPool.h>
+#include <muduo/net/InetAddress.h>
+#include <muduo/net/TcpConnection.h>
+#include <muduo/net/TcpServer.h>
+
+namespace http
+{
+// 和muduo::net::TcpServer接口一致的服务器，区别在于新连接分给哪个IO线程：
+// muduo按轮询分配，不管线程忙不忙；这里按负载挑选，跑AI搜索卡住的线程不会继续接新连接
+// 负载 = 当前连接数 + 事件循环延迟（毫秒）* kLagWeight
+// 事件循环延迟由主循环定期向每个IO线程投递探测任务测得，探测任务还没执行时按已等待的时间计算
+class LoadAwareTcpServer : muduo::noncopyable
+{
+public:
+    using ThreadInitCallback = std::function<void(muduo::net::EventLoop*)>;
+
+    static const int kLagWeight = 4; // 1ms的延迟相当于多少个连接
+    static constexpr double kProbeInterval = 0.05; // 探测间隔（秒）
+
+    LoadAwareTcpServer(muduo::net::EventLoop* loop,
+                       const muduo::net::InetAddress& listenAddr,
+                       const std::string& name,
+                       muduo::net::TcpServer::Option option = muduo::net::TcpServer::kNoReusePort);
+    ~LoadAwareTcpServer();
+
+    muduo::net::EventLoop* getLoop() const { return loop_; }
+    const std::string& name() const { return name_; }
+
+    // 需要在start()之前调用
+    void setThreadNum(int numThreads);
+    void setThreadInitCallback(const ThreadInitCallback& cb) { threadInitCallback_ = cb; }
+
+    void setConnectionCallback(const muduo::net::ConnectionCallback& cb) { connectionCallback_ = cb; }
+    void setMessageCallback(const muduo::net::MessageCallback& cb) { messageCallback_ = cb; }
+    void setWriteCompleteCallback(const muduo::net::WriteCompleteCallback& cb) { writeCompleteCallback_ = cb; }
+
+    // 必须在主循环所在线程调用
+    void start();
+
+private:
+    // 每个IO线程的负载信息，探测任务在IO线程中更新，主循环中读取
+    struct LoopLoad
+    {
+        muduo::net::EventLoop* loop = nullptr;
+        std::atomic<int> connections{0};
+        std::atomic<int64_t> lagUs{0}; // 最近一次测得的延迟
+        std::atomic<int64_t> probePostedUs{0}; // 未完成的探测任务的投递时间，0表示没有
+    };
+
+    void handleRead(); // 监听套接字可读，接受新连接
+    void newConnection(int sockfd, const muduo::net::InetAddress& peerAddr);
+    void removeConnection(const muduo::net::TcpConnectionPtr& conn);
+    void removeConnectionInLoop(const muduo::net::TcpConnectionPtr& conn);
+
+    LoopLoad* pickLoop();
+    void probeLoops();
+
+private:
+    muduo::net::EventLoop* loop_; // 主循环，负责accept
+    const std::string name_;
+    const std::string ipPort_;
+    int listenFd_;
+    int idleFd_; // 文件描述符耗尽时用来腾出位置拒绝连接
+    muduo::net::Channel acceptChannel_;
+    std::vector<std::unique_ptr<LoopLoad>> loads_;
+    std::map<muduo::net::EventLoop*, LoopLoad*> loadOfLoop_;
+    // 声明在loads_之后，先于它析构：IO线程退出之后，已经投递的探测任务不会再访问LoopLoad
+    std::unique_ptr<muduo::net::EventLoopThreadPool> threadPool_;
+    muduo::net::TimerId probeTimer_;
+
+    muduo::net::ConnectionCallback connectionCallback_;
+    muduo::net::MessageCallback messageCallback_;
+    muduo::net::WriteCompleteCallback writeCompleteCallback_;
+    ThreadInitCallback threadInitCallback_;
+
+    bool started_;
+    int nextConnId_;
+    std::map<std::string, muduo::net::TcpConnectionPtr> connections_; // 只在主循环中访问
+};
+
+} // namespace http
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <muduo/base/AsyncLogging.h>
+#include <muduo/base/noncopyable.h>
+#include <muduo/base/Timestamp.h>
+
+#include "../http/HttpRequest.h"
+#include "../http/HttpResponse.h"
+
+namespace http
+{
+namespace logging
+{
+// 单个IO线程私有的环形缓冲区：IO线程是唯一的生产者，后台刷盘线程是唯一的消费者
+// 写满时直接丢弃并计数，绝不阻塞IO线程
+class AccessLogBuffer : muduo::noncopyable
+{
+public:
+    static const size_t kSlots = 1024; // 槽位个数，必须是2的幂
+    static const size_t kLineSize = 256; // 每条访问日志的最大长度（超长的路径会被截断）
+
+    // 生产者：格式化一条访问日志到下一个空槽，成功返回true
+    bool append(const HttpRequest& req, const HttpResponse& resp, int64_t latencyUs, size_t bytes);
+
+    // 消费者：把已写好的槽依次交给output，返回处理的条数
+    template<typename Output>
+    size_t drain(Output&& output)
+    {
+        size_t head = head_.load(std::memory_order_relaxed);
+        size_t tail = tail_.load(std::memory_order_acquire);
+        for (size_t i = head; i != tail; ++i)
+        {
+            const Slot& slot = slots_[i & (kSlots - 1)];
+            output(slot.data, slot.len);
+        }
+        head_.store(tail, std::memory_order_release);
+        return tail - head;
+    }
+
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+    struct Slot
+    {
+        int len;
+        char data[kLineSize];
+    };
+
+    Slot slots_[kSlots];
+    std::atomic<size_t> head_{0}; // 消费者下一个要读的位置
+    std::atomic<size_t> tail_{0}; // 生产者下一个要写的位置
+    std::atomic<uint64_t> dropped_{0}; // 缓冲区写满时被丢弃的条数
+};
+
+// 结构化访问日志：每个请求一行（时间 方法 路径 状态码 耗时 字节数）
+// IO线程只写自己的环形缓冲区，后台线程定期收集后交给muduo::AsyncLogging写文件
+class AccessLogger : muduo::noncopyable
+{
+public:
+    // 单例模式
+    static AccessLogger& getInstance()
+    {
+        static AccessLogger instance;
+        return instance;
+    }
+
+    // basename: 日志文件名前缀，rollSize: 滚动大小，flushIntervalMs: 后台收集的间隔
+    void start(const std::string& basename, off_t rollSize = 64 * 1024 * 1024, int flushIntervalMs = 100);
+    void stop();
+    bool started() const { return running_.load(std::memory_order_acquire); }
+
+    // 在IO线程中调用，记录一次请求
+    void log(const HttpRequest& req, const HttpResponse& resp, size_t bytes);
+
+    // 所有线程累计丢弃的日志条数
+    uint64_t dropped() const;
+
+private:
+    AccessLogger() = default;
+    ~AccessLogger();
+
+    // 当前线程的环形缓冲区，第一次使用时创建并登记
+    AccessLogBuffer* threadBuffer();
+    void flushThreadFunc();
+    void drainAll();
+
+private:
+    std::unique_ptr<muduo::AsyncLogging> asyncLog_;
+    std::atomic<bool> running_{false};
+    int flushIntervalMs_ = 100;
+
+    mutable std::mutex mutex_; // 保护buffers_以及唤醒后台线程
+    std::condition_variable cv_;
+    std::vector<std::unique_ptr<AccessLogBuffer>> buffers_;
+    std::thread flushThread_;
+};
+
+} // namespace logging
+} // namespace http
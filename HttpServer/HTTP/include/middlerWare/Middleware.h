@@ -1,5 +1,7 @@
 #pragma once
 
+#include <functional>
+
 #include "../http/HttpRequest.h"
 #include "../http/HttpResponse.h"
 
@@ -11,12 +13,42 @@ namespace middleware
 class Middleware
 {
 public:
+    // 请求预处理的结果
+    enum Action
+    {
+        kContinue, // 继续交给后面的中间件和路由
+        kRespond, // 中间件已经在resp中写好了响应，直接返回给客户端
+        kPending // 还在等待IO，完成后通过Resume继续
+    };
+
+    // 异步的before完成时调用，参数为kContinue或kRespond
+    // 可以在任意线程调用，后续步骤会回到请求所在的IO线程执行
+    using Resume = std::function<void(Action)>;
+
     virtual ~Middleware() = default;
 
+    // 名字，用于调用链追踪，必须是字符串字面量
+    virtual const char* name() const { return "middleware"; }
+
     // 这个是请求预处理（比如处理预检请求，当方法是head或者options）
-    virtual void before(HttpRequest& req) = 0;
+    // 需要提前结束请求时把响应写进resp并返回kRespond，不要用抛异常的方式
+    virtual Action before(HttpRequest& req, HttpResponse& resp) = 0;
+    // before的异步版本，需要等待IO（如远程鉴权、集中式限流）的中间件重写它：
+    // 把工作交给别的线程后返回kPending，完成时调用一次resume，期间IO线程继续处理其他连接
+    // resume之前req和resp一直有效，但不能在别的线程里和IO线程同时访问它们；
+    // 到截止时间还没有resume时服务器先调用cancel再返回504
+    // 默认直接调用同步的before
+    virtual Action beforeAsync(HttpRequest& req, HttpResponse& resp, const Resume& resume)
+    {
+        (void)resume;
+        return before(req, resp);
+    }
     // 发送响应之前，对响应在进行处理（如果是cors，就是通过响应头告诉浏览器是否支持当前的跨域请求）
-    virtual void after(HttpResponse& resp) = 0;
+    // 只有before返回kContinue的中间件才会执行after
+    virtual void after(const HttpRequest& req, HttpResponse& resp) = 0;
+    // 请求没有走到after就结束了（处理时抛出异常、超时）时调用，只对已经放行的和正在等待的中间件调用
+    // 在请求所在的IO线程执行，用来释放before中占用的资源；之后不会再执行after，resume也不再有效果
+    virtual void cancel(const HttpRequest& req) { (void)req; }
     // 每个中间件都要实现自己的逻辑
 
     // 共有的方法，因为要实现链
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <functional>
 #include <vector>
 #include <memory>
 #include "Middleware.h"
@@ -11,14 +12,34 @@ namespace middleware
 class MiddlewareChain
 {
 public:
+    // 把一个步骤投递到请求所在的IO线程执行（在IO线程中调用时立即执行）
+    using Executor = std::function<void(std::function<void()>)>;
+    // 路由处理，处理完成时调用done（可能是异步的）
+    using Handler = std::function<void(const std::function<void()>& done)>;
+
     void addMiddleware(std::shared_ptr<Middleware> middleware);
-    // 请求按照顺序流过每一个中间件
-    void processBefore(HttpRequest& req);
-    // 响应按逆序流过每一个中间件
-    void processAfter(HttpResponse& resq);
+    // 请求按照顺序流过每一个中间件的before，都通过后执行handler，然后响应按逆序流过after，最后调用done
+    // 某个中间件返回kRespond时不再执行后面的中间件和handler，resp就是它给出的响应，
+    // 之后只有排在它前面（已经放行）的中间件执行after
+    // 中间件返回kPending或者handler异步完成时，后续步骤通过post回到IO线程继续，req和resp需要一直有效到done
+    // cancel非空时在开始处理之前设置为取消函数：请求没有走到done就结束时在IO线程调用，
+    // 通知已经进入的中间件（Middleware::cancel），之后的步骤不再执行；走到done之后调用没有效果
+    void process(HttpRequest& req, HttpResponse& resp, const Executor& post,
+                 const Handler& handler, const std::function<void()>& done,
+                 std::function<void()>* cancel = nullptr) const;
+
+    bool empty() const { return middlewares_.empty(); }
+
+private:
+    // 一次请求在链上的进度
+    struct Run;
+    static void runBefore(const std::shared_ptr<Run>& run);
+    static void resumeBefore(const std::shared_ptr<Run>& run, Middleware::Action action);
+    static void runAfter(const std::shared_ptr<Run>& run);
+    static void cancel(const std::shared_ptr<Run>& run);
 
 private:
     std::vector<std::shared_ptr<Middleware>> middlewares_;
 };
 }
-}
\ No newline at end of file
+}
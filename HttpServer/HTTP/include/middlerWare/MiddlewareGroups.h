@@ -0,0 +1,53 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "MiddlewareChain.h"
+
+namespace http
+{
+namespace middleware
+{
+// 按路由分组挂载中间件
+// 全局中间件对所有请求生效，分组中间件只对以某个路径前缀开头的请求生效（按路径段匹配，/user 不匹配 /username）
+// 启动时compile()为每个分组生成一条固定的中间件链（分组外层 + 全局 + 分组），请求到来时只需要按前缀挑一条链
+class MiddlewareGroups
+{
+public:
+    MiddlewareGroups() : compiled_(false) {}
+
+    void addGlobal(std::shared_ptr<Middleware> middleware);
+    void addToGroup(const std::string& prefix, std::shared_ptr<Middleware> middleware);
+    // 加在分组的最外层，在全局中间件之前执行before、之后执行after
+    // 全局中间件直接返回的响应（如限流的429）也会经过它的after，CORS这样的中间件挂在这里
+    void addOuterToGroup(const std::string& prefix, std::shared_ptr<Middleware> middleware);
+
+    // 生成各分组的中间件链，必须在开始处理请求之前调用，之后不能再添加中间件
+    void compile();
+
+    // 返回请求路径对应的中间件链，多个分组匹配时取前缀最长的
+    const MiddlewareChain& select(const std::string& path) const;
+
+private:
+    static bool matchPrefix(const std::string& path, const std::string& prefix);
+
+    struct Group
+    {
+        std::string prefix;
+        std::vector<std::shared_ptr<Middleware>> outer; // 在全局中间件之前
+        std::vector<std::shared_ptr<Middleware>> middlewares;
+        MiddlewareChain chain;
+    };
+
+    // 取得前缀对应的分组，没有时新建；"/"或空前缀返回nullptr，表示全局
+    Group* findGroup(const std::string& prefix);
+
+    bool compiled_;
+    std::vector<std::shared_ptr<Middleware>> global_;
+    std::vector<Group> groups_; // compile之后按前缀长度从长到短排列
+    MiddlewareChain globalChain_; // 没有匹配任何分组的请求使用
+};
+}
+}
@@ -0,0 +1,108 @@
+#pragma once
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <muduo/base/Timestamp.h>
+
+#include "../Middleware.h"
+
+namespace http
+{
+namespace middleware
+{
+// 响应缓存中间件，只缓存GET请求
+// 缓存键 = 方法 + 路径 + 路由配置的Vary请求头的值；每个路由单独设置过期时间
+// 缓存总字节数有上限，超出时按LRU淘汰
+// 多个请求同时未命中同一个键时只有第一个请求去计算（single-flight），其余的挂起（kPending）等它的结果，
+// 不占用IO线程；计算的请求异常或超时结束时由下一个等待的请求接着计算
+// 需要放在中间件链的最后，这样命中时前面的中间件（如CORS）仍然会处理响应
+class ResponseCacheMiddleware : public Middleware
+{
+public:
+    struct Stats
+    {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t coalesced; // 挂起等待其他请求计算结果的次数
+        uint64_t evictions;
+        size_t entries;
+        size_t bytes;
+    };
+
+    explicit ResponseCacheMiddleware(size_t maxBytes = 16 * 1024 * 1024);
+
+    // 缓存某个路径（精确匹配）的响应ttl秒，vary中的请求头不同时分别缓存；需要在服务器启动前调用
+    void cacheRoute(const std::string& path, double ttl, const std::vector<std::string>& vary = {});
+
+    // 清空缓存，数据变化时调用
+    void clear();
+
+    Stats stats() const;
+
+    const char* name() const override { return "responseCache"; }
+    // 同步调用时不等待其他请求的计算
+    Action before(HttpRequest& req, HttpResponse& resp) override;
+    Action beforeAsync(HttpRequest& req, HttpResponse& resp, const Resume& resume) override;
+    void after(const HttpRequest& req, HttpResponse& resp) override;
+    void cancel(const HttpRequest& req) override;
+
+private:
+    struct RouteRule
+    {
+        double ttl;
+        std::vector<std::string> vary;
+    };
+
+    struct Entry
+    {
+        std::string key;
+        HttpResponse::HttpStatusCode statusCode;
+        std::string statusMessage;
+        std::shared_ptr<const std::string> headersAndBody;
+        muduo::Timestamp expireAt;
+    };
+
+    // 挂起等待结果的请求，resume之前req和resp一直有效
+    struct Waiter
+    {
+        HttpRequest* req;
+        HttpResponse* resp;
+        Resume resume;
+    };
+
+    // 一次正在进行的计算
+    struct Flight
+    {
+        const HttpRequest* leader; // 正在计算的请求
+        std::vector<Waiter> waiters;
+    };
+
+    const RouteRule* findRule(const HttpRequest& req) const;
+    static std::string makeKey(const HttpRequest& req, const RouteRule& rule);
+    // 命中时把缓存的响应写入resp，调用时持有mutex_
+    bool lookupLocked(const std::string& key, const HttpRequest& req, HttpResponse& resp);
+    void insertLocked(Entry entry);
+
+private:
+    const size_t maxBytes_;
+    std::unordered_map<std::string, RouteRule> rules_;
+
+    mutable std::mutex mutex_;
+    std::list<Entry> lru_; // 最近使用的在前面
+    std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+    std::unordered_map<std::string, Flight> flights_;
+    size_t bytes_;
+
+    std::atomic<uint64_t> hits_;
+    std::atomic<uint64_t> misses_;
+    std::atomic<uint64_t> coalesced_;
+    std::atomic<uint64_t> evictions_;
+};
+
+}
+}
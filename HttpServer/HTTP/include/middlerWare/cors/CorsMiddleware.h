@@ -1,7 +1,9 @@
 #pragma once
+#include <string>
+#include <unordered_set>
+
 #include "../Middleware.h"
 #include "../../http/HttpRequest.h"
-#include "../../http/HttpRequest.h"
 #include "CorsConfig.h"
 
 namespace http
@@ -13,20 +15,27 @@ class CorsMiddleware : public Middleware
 public:
     explicit CorsMiddleware(const CorsConfig& config = CorsConfig::defaultConfig());
     
-    void before(HttpRequest& req) override; // 处理预检请求
-    void after(HttpResponse& resp) override;
+    const char* name() const override { return "cors"; }
+    Action before(HttpRequest& req, HttpResponse& resp) override; // 处理预检请求
+    void after(const HttpRequest& req, HttpResponse& resp) override;
 
     // 负责将字符串数组里的内容串起来形成一个更长的字符串
     std::string join(const std::vector<std::string>& strings, const std::string& delimiter);
 private:
     bool isOrigrinAllowed(const std::string& origrin) const;
     void handlePrefightRequest(const HttpRequest& req, HttpResponse& resp);
-    // 真正配置响应头的地方，内部会调用join
+    // 真正配置响应头的地方，预检请求的源是请求带来的，其余头部都是预先生成的
     void addCorsHeaders(HttpResponse& resp, const std::string& origin);// 处理预检请求，生成对应的响应
 
 private:
     CorsConfig config_;
 
+    // 以下内容在构造时根据配置生成一次，处理请求时只做追加
+    bool allowAllOrigins_;
+    std::unordered_set<std::string> allowedOrigins_;
+    std::string commonHeaders_; // Allow-Credentials/Methods/Headers/Max-Age 几行
+    std::string responseHeaders_; // 普通响应使用的完整CORS头部
+
 };
 }
 }
\ No newline at end of file
@@ -0,0 +1,85 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <muduo/net/EventLoop.h>
+
+#include "../Middleware.h"
+#include "../../session/SessionManager.h"
+#include "RateLimitPolicy.h"
+
+namespace http
+{
+namespace middleware
+{
+// 令牌桶限流中间件
+// 令牌桶用GCRA的形式实现：每个桶只保存一个"理论到达时间"，取令牌就是一次CAS，不需要加锁，也不需要后台线程补充令牌
+// 桶按客户端标识的哈希分片存放，分片的锁只在查找/插入桶时使用（读锁），不同客户端之间基本没有竞争
+// 被拒绝的请求直接返回预先序列化好的429响应，只需要设置状态行
+// 默认策略对所有请求生效，路由策略在它之上对单个路径再做限制，只有两者都放行时才消耗令牌
+// 作为全局中间件时，CORS要用HttpServer::addOuterMiddleware挂在它外面，429才会带上跨域头
+class RateLimitMiddleware : public Middleware
+{
+public:
+    static const int kShardCount = 16;
+
+    explicit RateLimitMiddleware(const RateLimitPolicy& defaultPolicy = RateLimitPolicy());
+
+    // 为某个路径单独设置策略（精确匹配），需要在服务器启动前调用
+    void addRoutePolicy(const std::string& path, const RateLimitPolicy& policy);
+
+    // 按会话限流的策略通过它验证请求中的会话，不会创建会话；需要在服务器启动前调用
+    void setSessionManager(session::SessionManager* sessionManager) { sessionManager_ = sessionManager; }
+
+    // 在loop中定期清理已经回满的桶，回满的桶和新建的桶没有区别，删掉不影响限流结果
+    void startExpiry(muduo::net::EventLoop* loop, double interval = 30.0);
+
+    const char* name() const override { return "rateLimit"; }
+    Action before(HttpRequest& req, HttpResponse& resp) override;
+    void after(const HttpRequest&, HttpResponse&) override {}
+
+    uint64_t rejected() const { return rejected_.load(std::memory_order_relaxed); }
+
+private:
+    struct Bucket
+    {
+        std::atomic<int64_t> tat{0}; // 理论到达时间（微秒），不大于当前时间时桶是满的
+    };
+
+    struct Shard
+    {
+        std::shared_mutex mutex;
+        std::unordered_map<std::string, std::unique_ptr<Bucket>> buckets;
+    };
+
+    // 每个策略一组分片和对应的429响应
+    struct PolicyState
+    {
+        RateLimitPolicy policy;
+        int64_t intervalUs; // 产生一个令牌的时间
+        int64_t burstUs; // 桶容量对应的时间
+        Shard shards[kShardCount];
+        std::shared_ptr<const std::string> rejectBody; // 429响应的头部和响应体
+    };
+
+    static std::unique_ptr<PolicyState> makeState(const RateLimitPolicy& policy);
+    std::string clientKey(const RateLimitPolicy& policy, const HttpRequest& req) const;
+    static bool take(Bucket& bucket, const PolicyState& state, int64_t now);
+    bool allow(PolicyState& state, const std::string& key, int64_t now);
+    // 退回allow取走的一个令牌
+    void refund(PolicyState& state, const std::string& key);
+    void expire();
+
+private:
+    std::vector<std::unique_ptr<PolicyState>> policies_; // policies_[0]是默认策略
+    std::unordered_map<std::string, PolicyState*> routePolicies_;
+    session::SessionManager* sessionManager_;
+    std::atomic<uint64_t> rejected_;
+};
+
+}
+}
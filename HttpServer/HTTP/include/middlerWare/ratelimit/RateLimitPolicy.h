@@ -0,0 +1,45 @@
+#pragma once
+#include <functional>
+#include <string>
+
+#include "../../http/HttpRequest.h"
+
+namespace http
+{
+namespace middleware
+{
+// 限流策略：每个客户端按ratePerSecond的速度获得令牌，最多攒burst个
+struct RateLimitPolicy
+{
+    // 用什么区分客户端
+    enum KeyType
+    {
+        kClientIp, // 客户端IP
+        kSessionId // 会话id（会话存储验证过的会话），没有会话或者限流中间件没有设置会话管理器时退回到客户端IP
+    };
+
+    double ratePerSecond = 20;
+    int burst = 40;
+    KeyType key = kClientIp;
+    // 自定义客户端标识（如用户id），设置后优先使用，返回空字符串时退回到key指定的方式
+    std::function<std::string(const HttpRequest&)> keyExtractor;
+
+    static RateLimitPolicy perIp(double ratePerSecond, int burst)
+    {
+        RateLimitPolicy policy;
+        policy.ratePerSecond = ratePerSecond;
+        policy.burst = burst;
+        policy.key = kClientIp;
+        return policy;
+    }
+
+    static RateLimitPolicy perSession(double ratePerSecond, int burst)
+    {
+        RateLimitPolicy policy = perIp(ratePerSecond, burst);
+        policy.key = kSessionId;
+        return policy;
+    }
+};
+
+}
+}
@@ -4,10 +4,10 @@
 #include <string>
 #include <memory>
 #include <functional>
-#include <regex>
 #include <vector>
 
 #include "RouterHandler.h"
+#include "StaticRouteTable.h"
 #include "../http/HttpRequest.h"
 #include "../http/HttpResponse.h"
 
@@ -16,7 +16,7 @@ namespace http
 namespace router
 {
 // 两种处理方式：简单的回调函数执行，复杂的处理逻辑交由处理器(执行多个相关函数)
-// 两种路由：静态路由注册回调，动态路由使用正则表达式统一，这样可以用一个处理器处理所有的动态路由
+// 两种路由：静态路由用哈希表精确匹配，动态路由放在按方法划分的压缩前缀树(radix tree)中，匹配耗时只和路径长度有关
 class Router
 {
 public:
@@ -54,71 +54,78 @@ public:
     void registerHandler(HttpRequest::Method method, const std::string& path, HandlerPtr handler); //注册到处理器，哈希表 key：方法+路径 value：处理器/回调
     void registerCallBack(HttpRequest::Method method, const std::string& path, const HandlerCallback& callback);// 注册到回调
 
-    // 动态路由的注册
-    void addRegexHandler(HttpRequest::Method method, const std::string& path, HandlerPtr handler)
+    // 使用编译期生成的静态路由表，需要在注册路由之前调用，table必须比Router活得久（一般是constexpr全局变量）
+    // 之后注册的静态路由如果在表里，就放进表对应的槽里，请求到来时不再构造RouterKey查哈希表；
+    // 不在表里的照旧放进哈希表
+    template <size_t N>
+    void useStaticTable(const StaticRouteTable<N>& table)
     {
-        std::regex pathRegex = convertToRegex(path); // 转化成正则
-        regexHandlers_.emplace_back(method, pathRegex, handler);
-
-    }
-    void addRegexCallback(HttpRequest::Method method, const std::string& path, const HandlerCallback& callback)
-    {
-        std::regex pathRegex = convertToRegex(path);
-        regexCallbacks_.emplace_back(method, pathRegex, callback);
+        staticTable_ = &table;
+        staticLookup_ = [](const void* t, HttpRequest::Method method, std::string_view path) {
+            return static_cast<const StaticRouteTable<N>*>(t)->find(method, path);
+        };
+        staticRoutes_.assign(N, Route());
     }
 
-    // 处理请求,执行回调
-    bool route(const HttpRequest& req, HttpResponse* resp);
+    // 动态路由的注册，路径中可以包含 :name 参数（匹配一段非斜杠字符）和末尾的 *name 通配（匹配剩余部分）
+    // 例如 /user/:id/games/:gameId、/static/*file
+    void addDynamicHandler(HttpRequest::Method method, const std::string& path, HandlerPtr handler);
+    void addDynamicCallback(HttpRequest::Method method, const std::string& path, const HandlerCallback& callback);
+
+    // 处理请求,执行回调；动态路由匹配到的参数直接写入req
+    // 处理完成时调用done：回调和同步处理器在返回前调用，异步处理器（见RouterHandler::handleAsync）完成时调用
+    // 没有匹配的路由时返回false，不调用done
+    bool route(HttpRequest& req, HttpResponse* resp, const RouterHandler::Done& done);
 
 private:
-    std::regex convertToRegex(const std::string& path)
+    // 动态路由的目标，参数名按在路径中出现的顺序保存
+    struct Route
     {
-        // 动态路由统一由一个处理器处理，但是如何让每个动态路由匹配到同一个处理器呢：正则
-        // ([^/]+) : 捕获非斜杠的任意字符序列
-        // /: ：匹配冒号前缀
-        std::string regexPattern = "^" + std::regex_replace(path, std::regex(R"(/:([^/]+))"), R"(/([^/]+))");
-        return std::regex(regexPattern);
-    }
+        HandlerPtr handler;
+        HandlerCallback callback;
+        std::vector<std::string> paramNames;
 
-    // 提取路径参数
-    void extractPathParameters(const std::smatch &match, HttpRequest& req)
-    {
-        
-        for(size_t i = 1; i < match.size(); ++i)
-        {// i = 0:整个匹配的字符串
-            // i >= 1: 匹配正则表达式中的捕获组（已经捕获到正则表达式了）
-            // /post/:123/05
-            // param1 : "123" , param2 : "05"
-            req.setPathParameters("param" + std::to_string(i), match[i].str());
-        }
-    }
+        bool empty() const { return !handler && !callback; }
+    };
 
-private:
-    struct RouteCallbackObj
+    // 压缩前缀树的节点：静态部分按公共前缀合并，参数和通配各占一个子节点
+    // 匹配时优先静态子节点，其次参数，最后通配，整个过程只扫描一遍路径
+    struct Node
     {
-        HttpRequest::Method method_;
-        std::regex pathRegex_;
-        HandlerCallback callback_;
-        RouteCallbackObj(HttpRequest::Method method, std::regex pathRegex, const HandlerCallback& callback) 
-                        : method_(method), pathRegex_(pathRegex), callback_(callback) {}
+        std::string prefix; // 静态子节点对应的路径片段
+        std::string indices; // 每个静态子节点prefix的首字符，和children一一对应
+        std::vector<std::unique_ptr<Node>> children;
+        std::unique_ptr<Node> paramChild; // :name
+        std::unique_ptr<Node> wildcardChild; // *name，一定是叶子
+        Route route;
     };
 
-    struct RouteHandlerObj
+    static const int kMethodCount = HttpRequest::kOptions + 1;
+
+    // 在编译期路由表中的下标，没有使用路由表或者不在表里时返回-1
+    int findStatic(HttpRequest::Method method, std::string_view path) const
     {
-        HttpRequest::Method method_;
-        std::regex pathRegex_;
-        HandlerPtr handler_;
-        RouteHandlerObj (HttpRequest::Method m, std::regex p, HandlerPtr h) : method_(m), pathRegex_(p), handler_(h) {}
-    };
+        return staticLookup_ ? staticLookup_(staticTable_, method, path) : -1;
+    }
 
+    static void invoke(const Route& target, HttpRequest& req, HttpResponse* resp, const RouterHandler::Done& done);
+
+    Route& insertRoute(HttpRequest::Method method, const std::string& path);
+    const Route* matchRoute(const Node* node, const std::string& path, size_t pos,
+                            size_t* offsets, size_t* lengths, int depth) const;
+
+private:
     // 第一个参数为key， 第二个参数为value， 第三个参数是哈希函数，如果不使用就是默认的红黑树的map
     std::unordered_map<RouterKey, HandlerPtr, RouteKeyHash> handlers_;
     std::unordered_map<RouterKey, HandlerCallback, RouteKeyHash> callbacks_;
 
-    std::vector<RouteHandlerObj> regexHandlers_;
-    std::vector<RouteCallbackObj> regexCallbacks_;
-
+    // 编译期路由表，按下标对应staticRoutes_
+    const void* staticTable_ = nullptr;
+    int (*staticLookup_)(const void*, HttpRequest::Method, std::string_view) = nullptr;
+    std::vector<Route> staticRoutes_;
 
+    // 每个方法一棵树
+    std::unique_ptr<Node> trees_[kMethodCount];
 };
 } // namespace router
 
@@ -2,6 +2,7 @@
 #pragma once
 #include <string>
 #include <memory>
+#include <functional>
 
 #include "../http/HttpRequest.h"
 #include "../http/HttpResponse.h"
@@ -13,8 +14,19 @@ namespace router
 class RouterHandler
 {
 public:
+    // 异步处理完成时调用，可以在任意线程调用，只能调用一次
+    using Done = std::function<void()>;
+
     virtual ~RouterHandler() = default;
     virtual void handle(const HttpRequest& req, HttpResponse* resp) = 0; //处理器处理处理逻辑执行的地方
+    // 耗时的处理器（等待IO、大量计算）重写这个方法，把工作交给别的线程，写好resp后调用done
+    // done之前req和resp一直有效；默认同步执行handle后立即调用done
+    // 到截止时间还没有调用done时服务器直接返回504，之后的done没有效果，所以resp只能在请求所在的IO线程中写
+    virtual void handleAsync(const HttpRequest& req, HttpResponse* resp, const Done& done)
+    {
+        handle(req, resp);
+        done();
+    }
 };
 }
 }
\ No newline at end of file
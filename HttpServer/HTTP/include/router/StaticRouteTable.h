@@ -0,0 +1,129 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+
+#include "../http/HttpRequest.h"
+
+namespace http
+{
+namespace router
+{
+// 编译期声明的静态路由
+struct StaticRoute
+{
+    HttpRequest::Method method;
+    std::string_view path;
+};
+
+// 槽的个数：不小于2N的2的幂，方便找到无冲突的种子，取模也变成位与
+constexpr size_t staticRouteSlots(size_t n)
+{
+    size_t slots = 1;
+    while (slots < 2 * n)
+    {
+        slots <<= 1;
+    }
+    return slots;
+}
+
+// 编译期生成的静态路由表
+// 构造时在编译期搜索一个种子，使所有路由的哈希值落在互不相同的槽里（完美哈希），
+// 查找时只算一次哈希、比较一次字符串，不构造std::string，也不分配内存
+// 路由重复或者找不到种子时抛异常，在常量表达式中就是编译错误
+//
+//   constexpr StaticRoute kRoutes[] = {{HttpRequest::kGet, "/"}, {HttpRequest::kPost, "/login"}};
+//   constexpr auto kRouteTable = makeStaticRouteTable(kRoutes);
+template <size_t N>
+class StaticRouteTable
+{
+public:
+    static constexpr size_t kSlots = staticRouteSlots(N);
+    static constexpr uint32_t kMaxSeed = 1 << 16;
+
+    constexpr explicit StaticRouteTable(const StaticRoute (&routes)[N])
+    {
+        for (size_t i = 0; i < N; ++i)
+        {
+            routes_[i] = routes[i];
+            for (size_t j = 0; j < i; ++j)
+            {
+                if (routes_[j].method == routes[i].method && routes_[j].path == routes[i].path)
+                {
+                    throw std::logic_error("duplicate static route");
+                }
+            }
+        }
+        for (uint32_t seed = 1; seed < kMaxSeed; ++seed)
+        {
+            if (tryBuild(seed))
+            {
+                seed_ = seed;
+                return;
+            }
+        }
+        throw std::logic_error("no perfect hash for static routes");
+    }
+
+    // 返回路由在声明数组中的下标，没有时返回-1
+    constexpr int find(HttpRequest::Method method, std::string_view path) const
+    {
+        int index = slots_[hash(method, path, seed_) & (kSlots - 1)];
+        if (index >= 0 && routes_[index].method == method && routes_[index].path == path)
+        {
+            return index;
+        }
+        return -1;
+    }
+
+    constexpr size_t size() const { return N; }
+    constexpr const StaticRoute& operator[](size_t index) const { return routes_[index]; }
+
+    // FNV-1a，最后再混合一次让低位分布更均匀
+    static constexpr uint32_t hash(HttpRequest::Method method, std::string_view path, uint32_t seed)
+    {
+        uint32_t h = 2166136261u ^ seed;
+        h = (h ^ static_cast<uint32_t>(method)) * 16777619u;
+        for (char c : path)
+        {
+            h = (h ^ static_cast<unsigned char>(c)) * 16777619u;
+        }
+        h ^= h >> 15;
+        h *= 0x2c1b3c6du;
+        h ^= h >> 12;
+        return h;
+    }
+
+private:
+    constexpr bool tryBuild(uint32_t seed)
+    {
+        for (size_t i = 0; i < kSlots; ++i)
+        {
+            slots_[i] = -1;
+        }
+        for (size_t i = 0; i < N; ++i)
+        {
+            size_t slot = hash(routes_[i].method, routes_[i].path, seed) & (kSlots - 1);
+            if (slots_[slot] >= 0)
+            {
+                return false;
+            }
+            slots_[slot] = static_cast<int16_t>(i);
+        }
+        return true;
+    }
+
+    StaticRoute routes_[N] {};
+    int16_t slots_[kSlots] {};
+    uint32_t seed_ = 0;
+};
+
+template <size_t N>
+constexpr StaticRouteTable<N> makeStaticRouteTable(const StaticRoute (&routes)[N])
+{
+    return StaticRouteTable<N>(routes);
+}
+
+} // namespace router
+} // namespace http
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "SessionStorage.h"
+
+namespace http
+{
+namespace session
+{
+// 无状态的会话存储，会话数据整个保存在cookie中，服务器不保存任何东西
+// 读取只需要校验签名，不访问任何共享状态，多个进程之间也不用共享存储，适合只保存userId这类少量数据的场景
+//
+// cookie的值是base64url编码的：
+//   uint8 版本 | uint8 密钥id | uint8 标志 | int64 过期时间(毫秒，大端) | 数据 | HMAC-SHA256(前面全部)
+// 加密时数据部分换成 12字节iv | AES-256-GCM密文 | 16字节tag，版本到过期时间作为附加数据参与认证，不再单独计算HMAC
+// 数据：uint8 id长度 | id | (uint16 键长度 | 键 | uint16 值长度 | 值)...
+//
+// 密钥轮换：第一个密钥用于签发，其余的只用于校验。新密钥放在最前面，旧密钥保留一个会话有效期后再去掉
+// 注意：cookie签发后在过期前一直有效，destroySession只能让浏览器删除cookie，不能吊销已经泄漏的cookie
+class CookieSessionStorage : public SessionStorage
+{
+public:
+    static const size_t kMinSecretBytes = 32;
+    static const size_t kMaxCookieBytes = 4000; // 浏览器对单个cookie的限制是4096字节
+
+    struct Key
+    {
+        uint8_t id; // 写入cookie，校验时据此选择密钥
+        std::string secret;
+    };
+
+    // keys为空、id重复或者密钥太短时抛std::invalid_argument
+    explicit CookieSessionStorage(const std::vector<Key>& keys, bool encrypt = false);
+
+    // 从文件读取密钥，每行 "id 密钥"，第一行是签发用的密钥，#开头的行是注释
+    // 文件打不开或者格式错误时抛std::runtime_error
+    static std::vector<Key> loadKeys(const std::string& path);
+
+    // 数据都在cookie里，保存和删除都不需要做任何事
+    void save(std::shared_ptr<Session> session) override {}
+    // sessionId是cookie的值，签名不对、格式错误或者已经过期时返回空
+    std::shared_ptr<Session> load(const std::string& sessionId) override;
+    void remove(const std::string& sessionId) override {}
+
+    bool storesInCookie() const override { return true; }
+    // 会话序列化后超过kMaxCookieBytes时抛std::length_error
+    std::string cookieValue(const Session& session) override;
+
+private:
+    static const uint8_t kVersion = 1;
+    static const uint8_t kEncrypted = 0x01;
+    static const size_t kHeaderBytes = 11;
+    static const size_t kMacBytes = 32;
+    static const size_t kIvBytes = 12;
+    static const size_t kTagBytes = 16;
+
+    // 由secret派生出的密钥，签名和加密使用不同的密钥
+    struct DerivedKey
+    {
+        uint8_t id;
+        unsigned char macKey[32];
+        unsigned char encKey[32];
+    };
+
+    const DerivedKey* findKey(uint8_t id) const;
+    std::string seal(const DerivedKey& key, const std::string& header, const std::string& body) const;
+    bool open(const DerivedKey& key, const std::string& token, std::string* body) const;
+
+    std::vector<DerivedKey> keys_; // 构造后不再修改，各IO线程只读
+    bool encrypt_;
+};
+}
+}
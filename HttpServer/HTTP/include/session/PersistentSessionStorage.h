@@ -0,0 +1,94 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+
+#include "SessionStorage.h"
+
+namespace http
+{
+namespace session
+{
+// 持久化的会话存储，重启后会话仍然有效
+// 磁盘上是一个只追加的记录日志，通过mmap写入；内存中保存 id -> 最新记录位置 的索引，启动时扫描一遍日志重建
+// 会话对象缓存在MemorySessionStorage中，没有缓存时从日志中的记录恢复
+//
+// 记录格式（本机字节序）：
+//   uint32 长度 | uint32 crc32 | uint8 类型(1写入 2删除) | int64 过期时间(毫秒) | uint16 id长度 | id |
+//   uint32 键值对个数 | (uint32 键长度 | 键 | uint32 值长度 | 值)...
+// 启动时遇到长度为0、越界或者校验失败的记录就认为日志到此结束（崩溃时写了一半的记录）
+//
+// 写入只拷贝到映射的内存，由后台线程每隔kSyncIntervalMs毫秒合并执行一次fdatasync（组提交），
+// 请求线程不等待磁盘；进程崩溃不丢数据，机器掉电最多丢失最近一个间隔内的修改
+// 日志超过kMinCompactBytes并且是有效记录的两倍以上时，后台线程把有效记录写入新文件后替换（压缩）
+//
+// 同一个日志只能由一个进程打开：各进程的日志末尾和索引互不知道，会互相覆盖记录，压缩时还会互相替换文件
+// 打开时对旁边的"<path>.lock"加flock排他锁（日志文件本身会在压缩时被替换，不能锁它），已经被占用时抛异常
+// 所以热升级时新旧进程不能使用同一个日志
+class PersistentSessionStorage : public SessionStorage
+{
+public:
+    static constexpr int kSyncIntervalMs = 10;
+    static constexpr uint64_t kGrowBytes = 4 * 1024 * 1024; // 文件每次扩大的大小
+    static constexpr uint64_t kMinCompactBytes = 8 * 1024 * 1024;
+
+    // maxCachedSessions: 内存中最多缓存的会话对象数，0表示不限制；日志中的会话不受这个限制
+    // 文件打不开或者已经被别的进程使用时抛std::runtime_error
+    explicit PersistentSessionStorage(const std::string& path, size_t maxCachedSessions = 0);
+    ~PersistentSessionStorage() override;
+
+    void save(std::shared_ptr<Session> session) override;
+    std::shared_ptr<Session> load(const std::string& sessionId) override;
+    void remove(const std::string& sessionId) override;
+    void cleanExpired() override;
+
+    size_t size() const; // 日志中有效的会话数
+    uint64_t logBytes() const;
+
+private:
+    struct IndexEntry
+    {
+        uint64_t offset; // 记录在文件中的偏移
+        uint32_t length; // 记录的总长度，含记录头
+        int64_t expiryMs;
+    };
+
+    void open();
+    void scan(); // 重建索引，找到日志末尾
+    bool mapFile(uint64_t capacity); // 把文件扩大到capacity并映射
+    void unmapFile();
+    // 追加一条记录，需要持有mutex_
+    uint64_t append(const std::string& record);
+    std::shared_ptr<Session> restore(const IndexEntry& entry) const; // 需要持有mutex_
+
+    void syncThreadFunc();
+    bool needCompact() const; // 需要持有mutex_
+    void compact();
+
+    const std::string path_;
+    int lockFd_; // "<path>.lock"，持有期间其他进程打不开这个日志
+    MemorySessionStorage cache_;
+
+    mutable std::mutex mutex_; // 保护下面的文件映射和索引
+    int fd_;
+    char* map_;
+    uint64_t capacity_; // 映射的大小，也是文件的大小
+    uint64_t tail_; // 日志末尾
+    uint64_t liveBytes_; // 上次压缩（或者启动）时有效记录的大小
+    std::unordered_map<std::string, IndexEntry> index_;
+
+    // 后台线程：组提交和压缩，文件的替换只在这个线程中进行
+    std::atomic<bool> running_;
+    std::mutex stopMutex_;
+    std::condition_variable stopCond_;
+    std::thread syncThread_;
+};
+
+} // namespace session
+} // namespace http
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <cstdint>
 #include <memory>
+#include <mutex>
 #include <unordered_map>
 #include <string>
 #include <chrono>
@@ -15,34 +17,109 @@ class SessionManager;
 
 class Session : public std::enable_shared_from_this<Session>
 {
+public:
+    // 有专门字段的键，通过setValue/getValue访问时也会转到这些字段上
+    static const std::string kUserIdKey;
+    static const std::string kUsernameKey;
+    static const std::string kLoggedInKey;
+
 private:
-    std::string  sessionId_; // 标识符，由manager生成
-    std::unordered_map<std::string, std::string> data_; // 以k-v的形式存该session对象的一切内容，sessionid,过期时间
+    enum Flag : uint8_t
+    {
+        kHasUserId = 0x01,
+        kLoggedIn = 0x02,
+        kDirty = 0x04, // 数据修改过，还没有写入存储
+        kDestroyed = 0x08 // 已经销毁，不再写入存储
+    };
+
+    const std::string  sessionId_; // 标识符，由manager生成
+    const int maxAge_; //过期时间，这是默认设置的，在构造session对象时会从那时的系统时间计算绝对时间
+    // 存储把同一个会话对象交给所有带着这个cookie的请求，它们可能在不同的IO线程上同时处理，
+    // 下面的字段都由mutex_保护；会话上的操作都很短，锁只在成员函数内部持有
+    mutable std::mutex mutex_;
     std::chrono::system_clock::time_point expiryTime_;
-    int maxAge_; //过期时间，这是默认设置的，在构造session对象时会从那时的系统时间计算绝对时间
+    std::chrono::system_clock::time_point savedExpiryTime_; // 上次写入存储时的过期时间
     SessionManager* sessionManager_;
+    uint8_t flags_;
+    // 几乎每个会话都有的数据直接保存，读取时不用查表也不用解析字符串
+    int64_t userId_;
+    std::string username_;
+    // 其他的键值对，第一次用到时才分配
+    std::unique_ptr<std::unordered_map<std::string, std::string>> extra_;
 
 public:
     Session(const std::string& sessionId, SessionManager* sessionManager, int maxAge = 3600);
 
     const std::string& getId() const {return sessionId_;}
-    
+
     // 会话管理
     bool isExpired() const;
-    void refresh(); // ExpiredTime
+    void refresh(); // ExpiredTime，和存储中的过期时间相差超过maxAge的十分之一时标记为脏
+    std::chrono::system_clock::time_point expiryTime() const;
+    void setExpiryTime(std::chrono::system_clock::time_point expiryTime);
+    int maxAge() const { return maxAge_; }
 
     // 关联管理器，通过管理器才能和内存建立关系
-    void setManager(SessionManager* SessionManager) { sessionManager_ = SessionManager; }
-    SessionManager* getManager() const { return sessionManager_; }
+    void setManager(SessionManager* SessionManager);
+    SessionManager* getManager() const;
+
+    // 修改只标记为脏，由服务器在请求处理完成后通过SessionManager::commit统一写入存储一次
+    bool isDirty() const;
+    void markDirty();
+    void clearDirty();
+    void markDestroyed();
+    bool isDestroyed() const;
 
-    // 操作自身属性的一些方法，修改属性需要更新内存（缓存）
+    // 常用数据的类型化访问，不分配内存；值没有变化时不标记为脏
+    bool hasUserId() const;
+    int64_t userId() const; // 没有设置时为0
+    void setUserId(int64_t userId);
+    std::string username() const;
+    void setUsername(const std::string& username);
+    bool isLoggedIn() const;
+    void setLoggedIn(bool loggedIn);
+
+    // 按字符串访问任意的键，userId不是整数时当作没有设置，isLoggedIn只有"true"表示已登录
     void setValue(const std::string& key, const std::string& value);
     std::string getValue(const std::string& key) const;
     void remove(const std::string& key);
 
     void clear();
 
+    // 按字符串遍历所有设置过的键值对，存储序列化会话时使用
+    // 整个遍历持有会话的锁，得到的是同一时刻的数据；f中不能再访问这个会话
+    template <typename F>
+    void forEachValue(F&& f) const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (flags_ & kHasUserId)
+        {
+            f(kUserIdKey, std::to_string(userId_));
+        }
+        if (!username_.empty())
+        {
+            f(kUsernameKey, username_);
+        }
+        if (flags_ & kLoggedIn)
+        {
+            f(kLoggedInKey, std::string("true"));
+        }
+        if (extra_)
+        {
+            for (const auto& kv : *extra_)
+            {
+                f(kv.first, kv.second);
+            }
+        }
+    }
+
+private:
+    // 以下需要持有mutex_
+    void setUserIdLocked(int64_t userId);
+    void setUsernameLocked(const std::string& username);
+    void setLoggedInLocked(bool loggedIn);
+    void removeLocked(const std::string& key);
 };
 
 }
-}
\ No newline at end of file
+}
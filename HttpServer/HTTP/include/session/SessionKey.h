@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace http
+{
+namespace session
+{
+// 128位的会话id，对外（cookie中）是32个十六进制字符，存储中保存为两个64位整数，哈希和比较都是整数运算
+struct SessionKey
+{
+    static const size_t kHexLength = 32;
+
+    uint64_t hi;
+    uint64_t lo;
+
+    bool operator==(const SessionKey& that) const { return hi == that.hi && lo == that.lo; }
+    bool operator!=(const SessionKey& that) const { return !(*this == that); }
+
+    // 从密码学安全的随机数生成，每个线程缓存一批RAND_bytes的结果，不加锁
+    // RAND_bytes失败时抛std::runtime_error
+    static SessionKey generate();
+    // id不是32个十六进制字符时返回false，不会分配内存
+    static bool parse(const std::string& id, SessionKey* key);
+    std::string toString() const;
+};
+
+// id本身是随机数，直接混合两半即可；分片用hi，哈希表用这里的结果
+struct SessionKeyHash
+{
+    size_t operator()(const SessionKey& key) const
+    {
+        return static_cast<size_t>(key.lo ^ (key.hi * 0x9e3779b97f4a7c15ULL));
+    }
+};
+}
+}
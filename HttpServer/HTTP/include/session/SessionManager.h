@@ -4,7 +4,7 @@
 #include "../http/HttpRequest.h"
 #include "../http/HttpResponse.h"
 #include <memory>
-#include <random> // 利用随机数生成器
+#include <muduo/net/EventLoop.h>
 
 namespace http
 {
@@ -15,16 +15,26 @@ class SessionManager
 public:
     explicit SessionManager(std::unique_ptr<SessionStorage> storage);
 
-    // 从请求中获取或者创建会话
+    // 从请求中获取或者创建会话，同一个请求中多次调用返回同一个会话
     std::shared_ptr<Session> getSession(const HttpRequest& req, HttpResponse* resp);
+    // 只查找请求Cookie中存储验证过的、没有过期的会话，不创建新会话，没有时返回空
+    std::shared_ptr<Session> findSession(const HttpRequest& req);
+    // 请求处理完成后由服务器调用，会话修改过时写入存储，每个请求最多写一次
+    // 会话保存在cookie中时，修改过就在resp中重新设置cookie，销毁了就让浏览器删除cookie
+    void commit(const HttpRequest& req, HttpResponse* resp);
 
     // 销毁会话
     void destroySession(const std::string& SessionId);
+    // 销毁请求中正在使用的会话，之后的修改不会再被提交
+    void destroySession(const std::shared_ptr<Session>& session);
     // 清理过期会话
     void cleanExpiredSessions();
-    // 更新会话
+    // 在loop中每隔interval秒清理一次过期会话
+    void startExpiry(muduo::net::EventLoop* loop, double interval = 1.0);
+    // 立即写入存储，不在请求中使用会话时调用
     void updateSessionId(std::shared_ptr<Session> session)
     {
+        session->clearDirty();
         storage_->save(session);
     }
 
@@ -32,9 +42,9 @@ private:
     std::string generateSessionId();
     std::string getSessionIdFromCookie(const HttpRequest& req);
     void setSessionCookie(const std::string& sessionId, HttpResponse* resq);
+    void clearSessionCookie(HttpResponse* resp);
 
 private:
-    std::mt19937 rng_;
     std::unique_ptr<SessionStorage> storage_;
 };
 }
@@ -1,6 +1,10 @@
 #pragma once
 #include "Session.h"
+#include "SessionKey.h"
+#include <list>
 #include <memory>
+#include <mutex>
+#include <vector>
 
 namespace http
 {
@@ -14,16 +18,77 @@ public:
     virtual void save(std::shared_ptr<Session> session) = 0;
     virtual std::shared_ptr<Session> load(const std::string& sessionId) = 0;
     virtual void remove(const std::string& sessionId) = 0;
+    // 清理过期会话，由SessionManager定时调用；默认不做任何事
+    virtual void cleanExpired();
+    // 会话数据保存在cookie中时返回true，这时每次会话修改后都要用cookieValue重新设置cookie
+    virtual bool storesInCookie() const;
+    // 写入cookie的值，默认就是会话id
+    virtual std::string cookieValue(const Session& session);
 };
 
+// 内存存储，所有IO线程并发访问
+// 按会话id的哈希分成多个分片，每个分片一把锁，不同会话的请求基本不会互相等待
+// 过期：每个分片一个按过期时间(秒)划分的时间轮，cleanExpired每次只检查到期的槽，且有检查个数的上限
+// 容量：每个分片按最近使用的顺序排列，超过容量时淘汰最久没有使用的会话
+// 键是会话id解析出的128位整数，不是SessionManager生成的id（32个十六进制字符）不会被保存，查找时直接返回空
 class MemorySessionStorage : public SessionStorage
 {
 public:
+    static const size_t kShardCount = 16; // 2的幂
+    static const size_t kWheelSize = 1024; // 时间轮的槽数，每个槽1秒，2的幂
+    static const size_t kMaxExpirePerShard = 1024; // 每个分片每次清理最多检查的会话数
+
+    // maxSessions: 最多保存的会话数，0表示不限制
+    explicit MemorySessionStorage(size_t maxSessions = 0);
+
     void save(std::shared_ptr<Session> session) override;
     std::shared_ptr<Session> load(const std::string& sessionId) override;
     void remove(const std::string& sessionId) override;
+    void cleanExpired() override;
+
+    size_t size() const;
+    size_t evictions() const;
+
 private:
-    std::unordered_map<std::string, std::shared_ptr<Session>> sessions_;
+    struct Item
+    {
+        std::shared_ptr<Session> session;
+        std::list<SessionKey>::iterator lru; // 在lru中的位置
+        int64_t wheelTick; // 当前登记在时间轮哪一秒的槽里
+        // 过期时间，只在分片锁内读写；请求线程会同时续期会话对象，清理时不读会话里的过期时间
+        std::chrono::system_clock::time_point expiry;
+    };
+
+    // 每个分片独占缓存行，避免相邻分片的锁互相影响
+    struct alignas(64) Shard
+    {
+        mutable std::mutex mutex;
+        std::unordered_map<SessionKey, Item, SessionKeyHash> sessions;
+        std::list<SessionKey> lru; // 最近使用的在前
+        // 槽里只记录id，会话续期时不移动，到期检查时再按实际的过期时间重新登记（惰性）
+        // 已经删除的会话留下的记录在检查时丢弃
+        std::vector<std::vector<SessionKey>> wheel;
+        int64_t cursor = 0; // 下一个要检查的秒
+        size_t evictions = 0;
+    };
+
+    using SessionMap = std::unordered_map<SessionKey, Item, SessionKeyHash>;
+
+    // 哈希表用的是两半混合的结果，分片只用hi的低位
+    Shard& shardFor(const SessionKey& key)
+    {
+        return shards_[key.hi & (kShardCount - 1)];
+    }
+
+    static int64_t expiryTick(std::chrono::system_clock::time_point expiry);
+    void schedule(Shard& shard, const SessionKey& key, Item& item);
+    // 返回被删除的会话，由调用方在锁外释放
+    std::shared_ptr<Session> erase(Shard& shard, SessionMap::iterator it);
+    void expireShard(Shard& shard, std::chrono::system_clock::time_point now,
+                     std::vector<std::shared_ptr<Session>>& released);
+
+    const size_t shardCapacity_; // 0表示不限制
+    Shard shards_[kShardCount];
 };
 }
 }
\ No newline at end of file
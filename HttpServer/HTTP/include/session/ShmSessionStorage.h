@@ -0,0 +1,104 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include "SessionStorage.h"
+
+namespace http
+{
+namespace session
+{
+// 共享内存中的会话存储，同一台机器上用SO_REUSEPORT监听同一个端口的多个进程共享会话
+// POSIX共享内存(shm_open)中是一个开放寻址（线性探测）的哈希表，每个桶固定256字节，键是128位的会话id
+//
+// 每个桶有一个顺序锁(seqlock)：序号为奇数时表示正在写
+//   读：不加锁，读序号 -> 拷贝 -> 再读序号，两次相同并且是偶数才算读到了完整的数据，否则重试
+//   写：用CAS把序号从偶数改成奇数（相当于加锁），写完后再加一
+// 写的进程在持有锁时崩溃，这个桶会一直是奇数，读写重试一定次数后放弃，把它当作没有这个会话
+//
+// 探测最多kMaxProbe个桶，找不到空位时覆盖其中最早过期的会话；删除留下墓碑，插入时复用
+// 会话数据序列化后超过kMaxDataBytes的不能保存，save抛std::length_error
+// 每次load都从共享内存中解码出新的Session对象，进程内不缓存
+class ShmSessionStorage : public SessionStorage
+{
+public:
+    static const size_t kBucketBytes = 256;
+    static const size_t kWords = kBucketBytes / 8 - 1; // 除去序号
+    static const size_t kHeaderWords = 4; // 状态和数据长度 | id高位 | id低位 | 过期时间
+    static const size_t kDataWords = kWords - kHeaderWords;
+    static const size_t kMaxDataBytes = kDataWords * 8; // 216字节
+    static const size_t kMaxProbe = 32;
+    static const size_t kMaxExpirePerCall = 4096; // 每次cleanExpired最多检查的桶数
+
+    // name: 共享内存的名字，例如"/gomoku_sessions"，第一个打开的进程负责创建和初始化
+    // capacity: 预计最多的会话数，桶数是不小于它1.25倍的2的幂；已经存在时必须和创建者一致
+    // 打开或者映射失败、已有的共享内存和参数不一致时抛std::runtime_error
+    ShmSessionStorage(const std::string& name, size_t capacity);
+    ~ShmSessionStorage() override;
+
+    void save(std::shared_ptr<Session> session) override;
+    std::shared_ptr<Session> load(const std::string& sessionId) override;
+    void remove(const std::string& sessionId) override;
+    // 每次从上次的位置继续检查kMaxExpirePerCall个桶，过期的改为墓碑
+    void cleanExpired() override;
+
+    size_t bucketCount() const { return bucketCount_; }
+    uint64_t evictions() const;
+
+    // 删除共享内存的名字，已经映射的进程不受影响，最后一个进程退出后内存释放
+    static void unlink(const std::string& name);
+
+private:
+    enum State : uint32_t
+    {
+        kEmpty = 0,
+        kUsed = 1,
+        kDeleted = 2
+    };
+
+    // 所有字段都用原子操作读写，读的一方可能和写的一方同时访问
+    struct alignas(64) Bucket
+    {
+        std::atomic<uint64_t> seq;
+        uint64_t words[kWords];
+    };
+    static_assert(sizeof(Bucket) == kBucketBytes, "bucket must be 256 bytes");
+    static_assert(kMaxDataBytes <= sizeof(Bucket::words) - kHeaderWords * 8, "session data must fit in the bucket");
+
+    struct alignas(64) Header
+    {
+        std::atomic<uint64_t> magic; // 初始化完成后才写入，其他进程等待它
+        uint64_t bucketCount;
+        uint64_t bucketBytes;
+        std::atomic<uint64_t> evictions;
+    };
+
+    // 读到的桶的前几个字
+    struct Snapshot
+    {
+        uint32_t state;
+        uint32_t dataLength;
+        SessionKey key;
+        int64_t expiryMs;
+    };
+
+    Bucket& bucket(size_t index) const { return buckets_[index & (bucketCount_ - 1)]; }
+    // 读取桶头，data不为空并且id等于key时一并拷贝数据；一直读不到一致的数据时返回false
+    bool read(const Bucket& b, Snapshot* snap, const SessionKey* key, uint64_t* data) const;
+    // 成功时返回加锁后的序号（奇数），重试多次仍然失败时返回0
+    static uint64_t lock(Bucket& b);
+    static void unlock(Bucket& b, uint64_t seq);
+    static void writeHeader(Bucket& b, State state, uint32_t dataLength, const SessionKey& key, int64_t expiryMs);
+
+    const std::string name_;
+    size_t bucketCount_;
+    size_t mappedBytes_;
+    void* map_;
+    Header* header_;
+    Bucket* buckets_;
+    std::atomic<size_t> expireCursor_; // 本进程下次清理开始的桶
+};
+}
+}
@@ -0,0 +1,171 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <muduo/base/noncopyable.h>
+#include <muduo/base/Timestamp.h>
+
+namespace http
+{
+namespace trace
+{
+// 一个已经结束的span
+// category和name必须是字符串字面量（只保存指针），请求路径这类动态内容放在detail里
+struct SpanRecord
+{
+    static const size_t kDetailSize = 64;
+
+    const char* category;
+    const char* name;
+    uint64_t traceId;
+    int64_t startUs;
+    int64_t durationUs;
+    char detail[kDetailSize];
+};
+
+// 单个线程私有的环形缓冲区，写满后覆盖最旧的记录
+// 只有所属线程写入，锁只在导出时才有竞争
+class TraceBuffer : muduo::noncopyable
+{
+public:
+    static const size_t kSlots = 4096; // 必须是2的幂
+
+    TraceBuffer(int tid, const char* threadName) : tid_(tid), threadName_(threadName) {}
+
+    void append(const SpanRecord& record);
+
+    template<typename Output>
+    void forEach(Output&& output) const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_t count = next_ < kSlots ? next_ : kSlots;
+        for (size_t i = next_ - count; i != next_; ++i)
+        {
+            output(slots_[i & (kSlots - 1)]);
+        }
+    }
+    void clear();
+
+    int tid() const { return tid_; }
+    const std::string& threadName() const { return threadName_; }
+
+private:
+    const int tid_;
+    const std::string threadName_;
+    mutable std::mutex mutex_;
+    SpanRecord slots_[kSlots];
+    size_t next_ = 0; // 下一个写入的位置，一直递增
+};
+
+// 请求级的调用链追踪
+// 请求开始时按采样率决定是否追踪，追踪的请求带一个trace id，处理过程中各环节用Span记录耗时，
+// 写入当前线程的环形缓冲区；没有被采样的请求只多一次线程局部变量的读取
+// 导出为Chrome trace event格式，可以直接用chrome://tracing或者Perfetto打开
+class Tracer : muduo::noncopyable
+{
+public:
+    static Tracer& getInstance()
+    {
+        static Tracer instance;
+        return instance;
+    }
+
+    // 采样率，0到1之间，默认0（不追踪）
+    void setSampleRate(double rate);
+    double sampleRate() const;
+
+    // 请求开始时调用，被采样时返回新的trace id，否则返回0
+    uint64_t sample();
+
+    // 记录一段已经结束的span，traceId为0时忽略
+    void record(const char* category, const char* name, uint64_t traceId,
+                muduo::Timestamp start, muduo::Timestamp end, const std::string& detail = std::string());
+
+    // 导出所有线程缓冲区中的span
+    std::string exportChromeJson() const;
+    void clear();
+
+    // 设置当前线程正在处理的请求的trace id，析构时恢复
+    // 请求的每一步（包括交给其他线程的异步处理）开始时都要设置
+    class Scope
+    {
+    public:
+        explicit Scope(uint64_t traceId) : saved_(current())
+        {
+            current() = traceId;
+        }
+        ~Scope() { current() = saved_; }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        friend class Tracer;
+        static uint64_t& current()
+        {
+            static thread_local uint64_t traceId = 0;
+            return traceId;
+        }
+        uint64_t saved_;
+    };
+
+    // 当前线程正在处理的请求的trace id，没有被采样时为0
+    static uint64_t current() { return Scope::current(); }
+
+private:
+    Tracer() = default;
+
+    // 当前线程的环形缓冲区，第一次使用时创建并登记
+    TraceBuffer* threadBuffer();
+
+private:
+    static const uint64_t kSampleAll = 1ULL << 32;
+    std::atomic<uint64_t> sampleThreshold_{0}; // 采样率 * 2^32
+    std::atomic<uint64_t> nextTraceId_{1};
+
+    mutable std::mutex mutex_; // 保护buffers_
+    std::vector<std::unique_ptr<TraceBuffer>> buffers_;
+};
+
+// 在作用域内记录一段span，当前请求没有被采样时什么都不做
+//   trace::Span span("db", "query");
+class Span
+{
+public:
+    Span(const char* category, const char* name)
+        : category_(category), name_(name), traceId_(Tracer::current())
+    {
+        if (traceId_)
+        {
+            start_ = muduo::Timestamp::now();
+        }
+    }
+    ~Span() { end(); }
+
+    Span(const Span&) = delete;
+    Span& operator=(const Span&) = delete;
+
+    // 提前结束
+    void end()
+    {
+        if (traceId_)
+        {
+            Tracer::getInstance().record(category_, name_, traceId_, start_, muduo::Timestamp::now());
+            traceId_ = 0;
+        }
+    }
+
+private:
+    const char* category_;
+    const char* name_;
+    uint64_t traceId_;
+    muduo::Timestamp start_;
+};
+
+} // namespace trace
+} // namespace http
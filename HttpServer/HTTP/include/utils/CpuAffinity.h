@@ -0,0 +1,116 @@
+#pragma once
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <muduo/base/Logging.h>
+
+namespace http
+{
+// 线程绑核配置
+struct CpuAffinityConfig
+{
+    std::vector<int> acceptCpus; // 主循环（负责accept）可以运行的CPU
+    std::vector<std::vector<int>> ioLoopCpus; // 第i个IO线程绑定到ioLoopCpus[i % size]
+    std::vector<int> workerCpus; // 计算线程池（如AI落子）的线程可以运行的CPU，池中的线程共用这个集合
+
+    bool empty() const { return acceptCpus.empty() && ioLoopCpus.empty() && workerCpus.empty(); }
+};
+
+class CpuAffinity
+{
+public:
+    // 解析 "0-3,8,10-11" 形式的CPU列表
+    // 有不是十进制数字的部分、区间反了或者CPU编号超出CPU_SETSIZE时抛std::invalid_argument
+    static std::vector<int> parseCpuList(const std::string& list)
+    {
+        std::vector<int> cpus;
+        size_t pos = 0;
+        while (pos < list.size())
+        {
+            size_t comma = list.find(',', pos);
+            if (comma == std::string::npos) comma = list.size();
+            std::string item = list.substr(pos, comma - pos);
+            if (!item.empty())
+            {
+                size_t dash = item.find('-');
+                int first = parseCpu(list, item.substr(0, dash));
+                int last = dash == std::string::npos ? first : parseCpu(list, item.substr(dash + 1));
+                if (last < first)
+                {
+                    throw std::invalid_argument("invalid cpu range \"" + item + "\" in \"" + list + "\"");
+                }
+                for (int cpu = first; cpu <= last; ++cpu)
+                {
+                    cpus.push_back(cpu);
+                }
+            }
+            pos = comma + 1;
+        }
+        return cpus;
+    }
+
+    // 解析 "0-1:2-3:4" 形式的多个CPU集合，用冒号分隔，格式不对时同样抛std::invalid_argument
+    static std::vector<std::vector<int>> parseCpuSets(const std::string& sets)
+    {
+        std::vector<std::vector<int>> result;
+        size_t pos = 0;
+        while (pos < sets.size())
+        {
+            size_t colon = sets.find(':', pos);
+            if (colon == std::string::npos) colon = sets.size();
+            std::vector<int> cpus = parseCpuList(sets.substr(pos, colon - pos));
+            if (!cpus.empty())
+            {
+                result.push_back(cpus);
+            }
+            pos = colon + 1;
+        }
+        return result;
+    }
+
+    // 把当前线程绑定到cpus上
+    // 绑核之后再分配的内存按照Linux的first-touch策略落在本地NUMA节点上，
+    // 所以要在线程开始分配自己的缓冲区之前调用
+    static bool pinCurrentThread(const std::vector<int>& cpus)
+    {
+        if (cpus.empty())
+        {
+            return true;
+        }
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : cpus)
+        {
+            if (cpu >= 0 && cpu < CPU_SETSIZE)
+            {
+                CPU_SET(cpu, &set);
+            }
+        }
+        int ret = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (ret != 0)
+        {
+            LOG_ERROR << "pthread_setaffinity_np failed: " << ret;
+            return false;
+        }
+        return true;
+    }
+
+private:
+    // 只接受十进制数字，atoi会把"x"当成0、把"1x"当成1
+    static int parseCpu(const std::string& list, const std::string& token)
+    {
+        bool digits = !token.empty() && token.size() <= 4 && token.find_first_not_of("0123456789") == std::string::npos;
+        int cpu = digits ? std::stoi(token) : -1;
+        if (cpu < 0 || cpu >= CPU_SETSIZE)
+        {
+            throw std::invalid_argument("invalid cpu \"" + token + "\" in \"" + list + "\"");
+        }
+        return cpu;
+    }
+};
+
+} // namespace http
@@ -24,10 +24,11 @@ public:
     { return file_.is_open(); }
     
     // 重置打开默认文件
-    void resetDefaultFile()
+    void resetDefaultFile(const std::string& defaultFile)
     {
         file_.close();
-        file_.open("/Gomoku/GomokuServer/resource/NotFound.html", std::ios::binary);
+        filePath_ = defaultFile;
+        file_.open(defaultFile, std::ios::binary);
     }
 
     uint64_t size()
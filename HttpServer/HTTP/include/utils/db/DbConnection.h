@@ -9,6 +9,8 @@
 #include <mysql/mysql.h> // 提供底层数据库操作接口（提供以上操作的接口）
 #include <muduo/base/Logging.h>
 #include "DbException.h"
+#include "../../http/Deadline.h"
+#include "../../trace/Tracer.h"
 
 namespace http
 {
@@ -48,6 +50,7 @@ public:
     template<typename... Args>
     sql::ResultSet* executeQuery(const std::string& sql, Args&&... args)
     {
+        trace::Span span("db", "query");
         std::lock_guard<std::mutex> lock(mutex_);
         try // 尝试执行可能出现异常的代码段
         {
@@ -59,6 +62,7 @@ public:
                 conn_->prepareStatement(sql)// 创建预处理语句
             );
             bindParams(stmt.get(), 1, std::forward<Args>(args)...);// 实现完美转发（左值或者右值）
+            applyDeadline(stmt.get());
             return stmt->executeQuery();
         }
         catch (const sql::SQLException& e) // 捕获出现的异常
@@ -72,6 +76,7 @@ public:
     template<typename... Args>
     int executeUpdate(const std::string& sql, Args&&... args)
     {
+        trace::Span span("db", "update");
         std::lock_guard<std::mutex> lock(mutex_);
         try
         {
@@ -79,6 +84,7 @@ public:
                 conn_->prepareStatement(sql) // 创建更新的预处理语句
             );
             bindParams(stmt.get(), 1, std::forward<Args>(args)...);
+            applyDeadline(stmt.get());
             return stmt->executeUpdate();
         }
         catch(const sql::SQLException& e)
@@ -90,6 +96,26 @@ public:
     }
     bool ping();// 测试连接状态
 private:
+    // 请求已超时则不再执行；否则把剩余时间设置为语句的超时时间
+    void applyDeadline(sql::PreparedStatement* stmt)
+    {
+        double remaining = Deadline::remaining();
+        if (remaining < 0)
+        {
+            return;
+        }
+        Deadline::check();
+        try
+        {
+            stmt->setQueryTimeout(static_cast<unsigned int>(remaining) + 1); // 单位为秒，向上取整
+        }
+        catch (const sql::SQLException& e)
+        {
+            // 驱动不支持语句超时，只能依靠执行前的检查
+            LOG_DEBUG << "setQueryTimeout not supported: " << e.what();
+        }
+    }
+
     // stmt- 预处理语句
     // index- 占位符“？”的位置，约定是从1开始
     // value可能是主键值，比如id = 25
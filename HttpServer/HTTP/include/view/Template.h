@@ -0,0 +1,81 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <muduo/base/noncopyable.h>
+
+namespace http
+{
+namespace view
+{
+// HTML模板：构造时把源文本切成字面量片段和占位符片段，渲染时按顺序追加，请求中不再解析模板
+// 语法：{{name}} 做HTML转义后插入，{{{name}}} 原样插入（例如内联到<script>中的JSON）
+// 同名的占位符可以出现多次，共用一个下标
+//
+//   Template page(source);
+//   Template::Values values(page);
+//   values.set("currentOnline", std::to_string(n));
+//   std::string html = page.render(values);
+class Template : muduo::noncopyable
+{
+public:
+    // 一次渲染用到的值，按占位符下标保存
+    class Values
+    {
+    public:
+        explicit Values(const Template& tmpl) : tmpl_(tmpl), values_(tmpl.slotCount()) {}
+
+        // 模板中没有这个占位符时忽略
+        Values& set(std::string_view name, std::string value)
+        {
+            int index = tmpl_.slot(name);
+            if (index >= 0)
+            {
+                values_[index] = std::move(value);
+            }
+            return *this;
+        }
+        const std::string& operator[](size_t index) const { return values_[index]; }
+
+    private:
+        const Template& tmpl_;
+        std::vector<std::string> values_;
+    };
+
+    // 模板片段直接引用source，owner持有source所在的内存，source是静态存储时可以为空
+    // 占位符没有闭合或者名字为空时抛std::invalid_argument
+    explicit Template(std::string_view source, std::shared_ptr<const void> owner = nullptr);
+
+    // 占位符的下标，没有时返回-1
+    int slot(std::string_view name) const;
+    size_t slotCount() const { return names_.size(); }
+    const std::shared_ptr<const void>& owner() const { return owner_; }
+
+    // values必须是用这个模板构造的
+    void render(const Values& values, std::string* out) const;
+    std::string render(const Values& values) const;
+
+    // 转义 & < > " '
+    static void appendEscaped(std::string_view text, std::string* out);
+
+private:
+    struct Segment
+    {
+        std::string_view text; // 字面量
+        int slot; // 占位符的下标，字面量为-1
+        bool escape;
+    };
+
+    int addSlot(std::string_view name);
+
+    std::shared_ptr<const void> owner_;
+    std::vector<Segment> segments_;
+    std::vector<std::string> names_;
+    size_t literalSize_; // 字面量的总长度，渲染前用来预留空间
+};
+
+} // namespace view
+} // namespace http
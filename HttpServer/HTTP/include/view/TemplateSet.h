@@ -0,0 +1,40 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <muduo/base/noncopyable.h>
+
+#include "Template.h"
+#include "../file/StaticFileServer.h"
+
+namespace http
+{
+namespace view
+{
+// 用StaticFileServer中的文件作为模板，第一次取用时编译，之后直接返回编译好的模板
+// 模板引用文件的内存，不复制；文件被重新加载后，下一次取用时重新编译
+class TemplateSet : muduo::noncopyable
+{
+public:
+    explicit TemplateSet(std::shared_ptr<const file::StaticFileServer> files);
+
+    // 文件不存在或者模板有语法错误时返回空
+    std::shared_ptr<const Template> get(const std::string& name);
+
+private:
+    struct Compiled
+    {
+        std::shared_ptr<const void> source; // 编译时文件的版本，编译失败时也记录，避免每次请求都重新编译
+        std::shared_ptr<const Template> tmpl;
+    };
+
+    std::shared_ptr<const file::StaticFileServer> files_;
+    std::mutex mutex_;
+    std::unordered_map<std::string, Compiled> templates_;
+};
+
+} // namespace view
+} // namespace http
@@ -0,0 +1,579 @@
+#include "../../include/file/StaticFileServer.h"
+#include "../../include/utils/FileUtils.h"
+
+#include <dirent.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include <muduo/base/Logging.h>
+
+namespace http
+{
+namespace file
+{
+namespace
+{
+struct MimeType
+{
+    const char* extension;
+    const char* type;
+    bool compressible;
+};
+
+const MimeType kMimeTypes[] = {
+    {"html", "text/html; charset=utf-8", true},
+    {"htm", "text/html; charset=utf-8", true},
+    {"css", "text/css; charset=utf-8", true},
+    {"js", "application/javascript; charset=utf-8", true},
+    {"json", "application/json", true},
+    {"txt", "text/plain; charset=utf-8", true},
+    {"svg", "image/svg+xml", true},
+    {"xml", "application/xml", true},
+    {"png", "image/png", false},
+    {"jpg", "image/jpeg", false},
+    {"jpeg", "image/jpeg", false},
+    {"gif", "image/gif", false},
+    {"ico", "image/x-icon", false},
+    {"webp", "image/webp", false},
+    {"woff", "font/woff", false},
+    {"woff2", "font/woff2", false},
+};
+
+const MimeType* findMimeType(const std::string& name)
+{
+    size_t dot = name.rfind('.');
+    if (dot == std::string::npos)
+    {
+        return nullptr;
+    }
+    std::string ext = name.substr(dot + 1);
+    for (char& c : ext)
+    {
+        c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+    }
+    for (const MimeType& mime : kMimeTypes)
+    {
+        if (ext == mime.extension)
+        {
+            return &mime;
+        }
+    }
+    return nullptr;
+}
+
+// 去掉首尾的空白并转成小写
+std::string normalizeToken(const std::string& s)
+{
+    size_t begin = s.find_first_not_of(" \t");
+    if (begin == std::string::npos)
+    {
+        return "";
+    }
+    size_t end = s.find_last_not_of(" \t");
+    std::string token = s.substr(begin, end - begin + 1);
+    for (char& c : token)
+    {
+        c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+    }
+    return token;
+}
+
+// Accept-Encoding中gzip的q值大于0时才能返回压缩的版本，"gzip;q=0"表示明确拒绝
+// 没有列出gzip时看"*"
+bool acceptsGzip(const std::string& acceptEncoding)
+{
+    int gzip = -1; // -1没有列出，0拒绝，1接受
+    int any = -1;
+    size_t pos = 0;
+    while (pos < acceptEncoding.size())
+    {
+        size_t comma = acceptEncoding.find(',', pos);
+        if (comma == std::string::npos) comma = acceptEncoding.size();
+        std::string item = acceptEncoding.substr(pos, comma - pos);
+        pos = comma + 1;
+
+        size_t semi = item.find(';');
+        std::string coding = normalizeToken(item.substr(0, semi));
+        bool accepted = true;
+        if (semi != std::string::npos)
+        {
+            std::string params = normalizeToken(item.substr(semi + 1));
+            size_t q = params.find("q=");
+            if (q != std::string::npos)
+            {
+                accepted = strtod(params.c_str() + q + 2, nullptr) > 0;
+            }
+        }
+        if (coding == "gzip" || coding == "x-gzip")
+        {
+            gzip = accepted;
+        }
+        else if (coding == "*")
+        {
+            any = accepted;
+        }
+    }
+    return gzip >= 0 ? gzip == 1 : any == 1;
+}
+
+// 目录项的类型；指向目录的符号链接不跟随，它可能指回上层目录形成环，指向普通文件的照常加载
+enum EntryKind
+{
+    kOtherEntry,
+    kDirectoryEntry,
+    kRegularFileEntry
+};
+
+EntryKind entryKind(const std::string& path)
+{
+    struct stat st;
+    if (::lstat(path.c_str(), &st) != 0)
+    {
+        return kOtherEntry;
+    }
+    bool link = S_ISLNK(st.st_mode);
+    if (link && ::stat(path.c_str(), &st) != 0)
+    {
+        return kOtherEntry; // 悬空的链接
+    }
+    if (S_ISDIR(st.st_mode))
+    {
+        if (link)
+        {
+            LOG_WARN << "Symlinked static directory skipped: " << path;
+            return kOtherEntry;
+        }
+        return kDirectoryEntry;
+    }
+    return S_ISREG(st.st_mode) ? kRegularFileEntry : kOtherEntry;
+}
+
+// 内容的FNV-1a哈希作为强ETag，内容不变时重启后也一样
+std::string makeEtag(const std::string& content)
+{
+    uint64_t h = 14695981039346656037ULL;
+    for (unsigned char c : content)
+    {
+        h = (h ^ c) * 1099511628211ULL;
+    }
+    char buf[24];
+    snprintf(buf, sizeof(buf), "\"%016llx\"", static_cast<unsigned long long>(h));
+    return buf;
+}
+
+// gzip版本的字节不同，强ETag也要不同，在原始内容的ETag引号内加上"-gz"
+std::string makeGzipEtag(const std::string& etag)
+{
+    return etag.substr(0, etag.size() - 1) + "-gz\"";
+}
+
+// gzip格式压缩，失败时返回false
+bool gzipCompress(const std::string& input, std::string& output)
+{
+    z_stream stream{};
+    // windowBits加16表示输出gzip头而不是zlib头
+    if (deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+        return false;
+    }
+    output.resize(deflateBound(&stream, input.size()));
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+    stream.avail_in = static_cast<uInt>(input.size());
+    stream.next_out = reinterpret_cast<Bytef*>(&output[0]);
+    stream.avail_out = static_cast<uInt>(output.size());
+    int ret = deflate(&stream, Z_FINISH);
+    output.resize(stream.total_out);
+    deflateEnd(&stream);
+    return ret == Z_STREAM_END;
+}
+
+std::string joinPath(const std::string& dir, const std::string& name)
+{
+    return dir.empty() ? name : dir + "/" + name;
+}
+} // namespace
+
+StaticFileServer::StaticFileServer(const std::string& root, const std::string& urlPrefix)
+    : root_(root)
+    , urlPrefix_(urlPrefix)
+    , files_(std::make_shared<const FileMap>())
+    , inotifyFd_(-1)
+{
+}
+
+StaticFileServer::~StaticFileServer()
+{
+    if (inotifyChannel_)
+    {
+        inotifyChannel_->disableAll();
+        inotifyChannel_->remove();
+    }
+    if (inotifyFd_ >= 0)
+    {
+        ::close(inotifyFd_);
+    }
+}
+
+const char* StaticFileServer::contentType(const std::string& name)
+{
+    const MimeType* mime = findMimeType(name);
+    return mime ? mime->type : "application/octet-stream";
+}
+
+size_t StaticFileServer::load()
+{
+    if (root_.empty())
+    {
+        return 0;
+    }
+    auto files = std::make_shared<FileMap>();
+    scanDir("", *files);
+    size_t count = files->size();
+    setFiles(std::move(files));
+    LOG_INFO << "Static files loaded from " << root_ << ": " << count << " files";
+    return count;
+}
+
+size_t StaticFileServer::loadEmbedded(const EmbeddedResourceTable& table)
+{
+    auto files = std::make_shared<FileMap>(*this->files());
+    for (size_t i = 0; i < table.count; ++i)
+    {
+        const EmbeddedResource& resource = table.resources[i];
+        auto entry = std::make_shared<Entry>();
+        entry->etag = resource.etag;
+        entry->plain = resource.plain;
+        entry->gzip = resource.gzip;
+        entry->notModified = resource.notModified;
+        entry->gzipEtag = resource.gzipEtag;
+        entry->gzipNotModified = resource.gzipNotModified;
+        size_t headerEnd = resource.plain.find("\r\n\r\n");
+        entry->body = resource.plain.substr(headerEnd == std::string_view::npos ? 0 : headerEnd + 4);
+        files->emplace(std::string(resource.name), std::move(entry)); // 已经有同名文件时不覆盖
+    }
+    setFiles(std::move(files));
+    LOG_INFO << "Embedded static files loaded: " << table.count << " files";
+    return table.count;
+}
+
+std::shared_ptr<const void> StaticFileServer::content(const std::string& name, std::string_view* body) const
+{
+    std::shared_ptr<const FileMap> files = this->files();
+    auto it = files->find(name);
+    if (it == files->end())
+    {
+        return nullptr;
+    }
+    *body = it->second->body;
+    return it->second;
+}
+
+size_t StaticFileServer::fileCount() const
+{
+    return files()->size();
+}
+
+bool StaticFileServer::serveFile(const std::string& name, const HttpRequest& req, HttpResponse* resp) const
+{
+    std::shared_ptr<const FileMap> files = this->files();
+    auto it = files->find(name);
+    if (it == files->end())
+    {
+        return false;
+    }
+    const std::shared_ptr<const Entry>& entry = it->second;
+
+    const std::string ifNoneMatch = req.getHeader("If-None-Match");
+    // 两个版本的ETag都可以验证，304带回匹配上的那一个
+    // "abc"不会匹配到"abc-gz"中，引号是ETag的一部分
+    std::string_view notModified;
+    if (!ifNoneMatch.empty())
+    {
+        if (ifNoneMatch.find(entry->etag) != std::string::npos)
+        {
+            notModified = entry->notModified;
+        }
+        else if (!entry->gzipEtag.empty() && ifNoneMatch.find(entry->gzipEtag) != std::string::npos)
+        {
+            notModified = entry->gzipNotModified;
+        }
+    }
+    // 响应持有entry，文件在响应发出之前被重新加载也没有关系
+    if (!notModified.empty())
+    {
+        resp->setStatusLine(HttpResponse::k304NotModified, "Not Modified", req.getVersion());
+        resp->setPreformatted(notModified, entry);
+        return true;
+    }
+    resp->setStatusLine(HttpResponse::k200Ok, "OK", req.getVersion());
+    bool gzip = !entry->gzip.empty() && acceptsGzip(req.getHeader("Accept-Encoding"));
+    resp->setPreformatted(gzip ? entry->gzip : entry->plain, entry);
+    return true;
+}
+
+std::shared_ptr<const StaticFileServer::Entry> StaticFileServer::buildEntry(const std::string& name,
+                                                                            const std::string& content)
+{
+    const MimeType* mime = findMimeType(name);
+    auto entry = std::make_shared<Entry>();
+    std::string& etag = entry->storage[0];
+    std::string& plain = entry->storage[1];
+    std::string& gzip = entry->storage[2];
+    std::string& notModified = entry->storage[3];
+    std::string& gzipEtag = entry->storage[4];
+    std::string& gzipNotModified = entry->storage[5];
+    etag = makeEtag(content);
+
+    // 每次都要和服务器确认ETag，文件更新后浏览器能马上拿到新内容
+    // 格式和cmake/EmbedResources.cmake生成的一致
+    std::string contentType = "Content-Type: ";
+    contentType += mime ? mime->type : "application/octet-stream";
+    contentType += "\r\n";
+    std::string cacheControl = "Cache-Control: no-cache\r\n";
+    if (mime && mime->compressible)
+    {
+        cacheControl += "Vary: Accept-Encoding\r\n";
+    }
+
+    plain = contentType + "ETag: " + etag + "\r\n" + cacheControl;
+    plain += "Content-Length: " + std::to_string(content.size()) + "\r\n\r\n";
+    plain += content;
+
+    std::string compressed;
+    if (mime && mime->compressible && gzipCompress(content, compressed) && compressed.size() < content.size())
+    {
+        gzipEtag = makeGzipEtag(etag);
+        gzip = contentType + "ETag: " + gzipEtag + "\r\n" + cacheControl;
+        gzip += "Content-Encoding: gzip\r\nContent-Length: " + std::to_string(compressed.size()) + "\r\n\r\n";
+        gzip += compressed;
+        gzipNotModified = "ETag: " + gzipEtag + "\r\nCache-Control: no-cache\r\n\r\n";
+    }
+    notModified = "ETag: " + etag + "\r\nCache-Control: no-cache\r\n\r\n";
+
+    entry->etag = etag;
+    entry->plain = plain;
+    entry->gzip = gzip;
+    entry->notModified = notModified;
+    entry->gzipEtag = gzipEtag;
+    entry->gzipNotModified = gzipNotModified;
+    entry->body = entry->plain.substr(plain.size() - content.size());
+    return entry;
+}
+
+void StaticFileServer::scanDir(const std::string& dir, FileMap& files)
+{
+    std::string path = joinPath(root_, dir);
+    DIR* d = ::opendir(path.c_str());
+    if (!d)
+    {
+        LOG_WARN << "Cannot open static directory " << path;
+        return;
+    }
+    while (struct dirent* ent = ::readdir(d))
+    {
+        std::string name = ent->d_name;
+        if (name == "." || name == "..")
+        {
+            continue;
+        }
+        std::string rel = joinPath(dir, name);
+        EntryKind kind = entryKind(joinPath(root_, rel));
+        if (kind == kDirectoryEntry)
+        {
+            scanDir(rel, files);
+        }
+        else if (kind == kRegularFileEntry)
+        {
+            std::string content;
+            if (readFile(rel, content))
+            {
+                files[rel] = buildEntry(rel, content);
+            }
+        }
+    }
+    ::closedir(d);
+}
+
+bool StaticFileServer::readFile(const std::string& name, std::string& content) const
+{
+    std::string path = joinPath(root_, name);
+    FileUtil file(path);
+    if (!file.isValid())
+    {
+        return false;
+    }
+    uint64_t size = file.size();
+    if (size > kMaxFileSize)
+    {
+        LOG_WARN << "Static file too large, not cached: " << path << " size=" << size;
+        return false;
+    }
+    std::vector<char> buffer(size);
+    file.readFile(buffer);
+    content.assign(buffer.data(), buffer.size());
+    return true;
+}
+
+void StaticFileServer::reloadFile(const std::string& name)
+{
+    std::string content;
+    // 新建的也可能是指向目录的符号链接
+    if (entryKind(joinPath(root_, name)) != kRegularFileEntry || !readFile(name, content))
+    {
+        removeFile(name);
+        return;
+    }
+    auto files = std::make_shared<FileMap>(*this->files());
+    (*files)[name] = buildEntry(name, content);
+    setFiles(std::move(files));
+    LOG_INFO << "Static file reloaded: " << name;
+}
+
+void StaticFileServer::removeFile(const std::string& name)
+{
+    auto files = std::make_shared<FileMap>(*this->files());
+    // 删除的可能是目录，把目录下的文件一起去掉
+    std::string dirPrefix = name + "/";
+    size_t before = files->size();
+    for (auto it = files->begin(); it != files->end();)
+    {
+        if (it->first == name || it->first.compare(0, dirPrefix.size(), dirPrefix) == 0)
+        {
+            it = files->erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+    if (files->size() != before)
+    {
+        setFiles(std::move(files));
+        LOG_INFO << "Static file removed: " << name;
+    }
+}
+
+void StaticFileServer::watch(muduo::net::EventLoop* loop)
+{
+    if (root_.empty())
+    {
+        return;
+    }
+    inotifyFd_ = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd_ < 0)
+    {
+        LOG_SYSERR << "inotify_init1 failed, static files under " << root_ << " will not be reloaded";
+        return;
+    }
+    addWatch("");
+    inotifyChannel_ = std::make_unique<muduo::net::Channel>(loop, inotifyFd_);
+    inotifyChannel_->setReadCallback([this](muduo::Timestamp) { handleEvents(); });
+    inotifyChannel_->enableReading();
+}
+
+void StaticFileServer::addWatch(const std::string& dir)
+{
+    std::string path = joinPath(root_, dir);
+    int wd = ::inotify_add_watch(inotifyFd_, path.c_str(),
+                                 IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_CREATE | IN_ONLYDIR);
+    if (wd < 0)
+    {
+        LOG_SYSERR << "inotify_add_watch " << path;
+        return;
+    }
+    watches_[wd] = dir;
+
+    // 子目录也要单独监听
+    DIR* d = ::opendir(path.c_str());
+    if (!d)
+    {
+        return;
+    }
+    while (struct dirent* ent = ::readdir(d))
+    {
+        std::string name = ent->d_name;
+        if (name == "." || name == "..")
+        {
+            continue;
+        }
+        std::string rel = joinPath(dir, name);
+        if (entryKind(joinPath(root_, rel)) == kDirectoryEntry)
+        {
+            addWatch(rel);
+        }
+    }
+    ::closedir(d);
+}
+
+void StaticFileServer::handleEvents()
+{
+    alignas(struct inotify_event) char buf[4096];
+    while (true)
+    {
+        ssize_t n = ::read(inotifyFd_, buf, sizeof(buf));
+        if (n <= 0)
+        {
+            break;
+        }
+        for (char* p = buf; p < buf + n;)
+        {
+            const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(p);
+            p += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_IGNORED)
+            {
+                watches_.erase(event->wd); // 目录被删除，监听自动失效
+                continue;
+            }
+            auto it = watches_.find(event->wd);
+            if (it == watches_.end() || event->len == 0)
+            {
+                continue;
+            }
+            std::string name = joinPath(it->second, event->name);
+            if (event->mask & IN_ISDIR)
+            {
+                if (event->mask & (IN_CREATE | IN_MOVED_TO))
+                {
+                    // 新目录：监听它，并加载其中已有的文件
+                    addWatch(name);
+                    auto files = std::make_shared<FileMap>(*this->files());
+                    scanDir(name, *files);
+                    setFiles(std::move(files));
+                }
+                else if (event->mask & (IN_DELETE | IN_MOVED_FROM))
+                {
+                    removeFile(name);
+                }
+            }
+            else if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO))
+            {
+                // 写完或者整个替换（编辑器一般先写临时文件再改名）后才重新加载，不会读到写了一半的文件
+                reloadFile(name);
+            }
+            else if (event->mask & (IN_DELETE | IN_MOVED_FROM))
+            {
+                removeFile(name);
+            }
+        }
+    }
+}
+
+std::shared_ptr<const StaticFileServer::FileMap> StaticFileServer::files() const
+{
+    return std::atomic_load(&files_);
+}
+
+void StaticFileServer::setFiles(std::shared_ptr<const FileMap> files)
+{
+    std::atomic_store(&files_, std::move(files));
+}
+
+} // namespace file
+} // namespace http
@@ -0,0 +1,354 @@
+#include "../../include/http/HotUpgrade.h"
+#include <muduo/base/Logging.h>
+
+#include <arpa/inet.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cstdlib>
+#include <cstring>
+
+namespace http
+{
+namespace
+{
+// 新进程连接控制套接字后发送的升级请求，只连接不发送的（如running()）不会触发交接
+const char kUpgradeRequest = 'U';
+
+int connectControl(const std::string& path)
+{
+    int sock = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (sock < 0)
+    {
+        LOG_SYSERR << "HotUpgrade socket";
+        return -1;
+    }
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    if (::connect(sock, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0)
+    {
+        ::close(sock);
+        return -1;
+    }
+    return sock;
+}
+} // namespace
+
+HotUpgrade::HotUpgrade(const std::string& controlPath, uint16_t port)
+    : controlPath_(controlPath)
+    , port_(port)
+    , controlFd_(-1)
+    , tookOver_(false)
+    , listenFd_(-1)
+{}
+
+HotUpgrade::~HotUpgrade()
+{
+    if (controlFd_ >= 0)
+    {
+        ::close(controlFd_);
+    }
+    int fd = listenFd_.exchange(-1);
+    if (fd >= 0)
+    {
+        ::shutdown(fd, SHUT_RDWR); // 唤醒阻塞在accept上的后台线程
+    }
+    if (acceptThread_.joinable())
+    {
+        acceptThread_.join();
+    }
+    if (fd >= 0)
+    {
+        ::close(fd); // 后台线程退出后再关闭，fd不会在它使用期间被复用
+    }
+}
+
+bool HotUpgrade::takeOver()
+{
+    int sock = connectControl(controlPath_);
+    if (sock < 0)
+    {
+        // 没有旧进程在运行，正常启动
+        LOG_INFO << "No running server on " << controlPath_ << ", starting fresh";
+        return false;
+    }
+
+    int inherited = -1;
+    if (::write(sock, &kUpgradeRequest, 1) == 1)
+    {
+        inherited = recvFd(sock);
+    }
+    if (inherited < 0)
+    {
+        LOG_ERROR << "Failed to receive listening socket from old process";
+        ::close(sock);
+        return false;
+    }
+
+    // LoadAwareTcpServer在构造时已经创建并bind了自己的套接字（还没有listen）
+    // 用旧进程的监听套接字覆盖它，这样后续的listen/accept都作用在继承来的套接字上
+    // 旧套接字上已经排队但还没accept的连接因此不会丢失
+    int own = findSocket(false);
+    if (own < 0)
+    {
+        LOG_ERROR << "Cannot find acceptor socket bound to port " << port_;
+        ::close(inherited);
+        ::close(sock);
+        return false;
+    }
+    if (::dup2(inherited, own) < 0)
+    {
+        LOG_SYSERR << "HotUpgrade::takeOver dup2";
+        ::close(inherited);
+        ::close(sock);
+        return false;
+    }
+    ::close(inherited);
+    ::fcntl(own, F_SETFD, FD_CLOEXEC); // dup2会清除close-on-exec标志
+
+    controlFd_ = sock;
+    tookOver_ = true;
+    LOG_INFO << "Took over listening socket on port " << port_ << " from old process";
+    return true;
+}
+
+void HotUpgrade::notifyReady()
+{
+    if (controlFd_ < 0)
+    {
+        return;
+    }
+    char ack = 'R';
+    if (::write(controlFd_, &ack, 1) != 1)
+    {
+        LOG_SYSERR << "HotUpgrade::notifyReady";
+    }
+    ::close(controlFd_);
+    controlFd_ = -1;
+}
+
+bool HotUpgrade::running() const
+{
+    int sock = connectControl(controlPath_);
+    if (sock < 0)
+    {
+        return false;
+    }
+    ::close(sock);
+    return true;
+}
+
+void HotUpgrade::listen(const HandoffCallback& cb)
+{
+    handoffCallback_ = cb;
+    // 刚接管时旧进程收到确认后才关闭控制套接字，这时连接仍然会成功，不需要检查
+    if (!tookOver_ && running())
+    {
+        LOG_ERROR << "Another server is listening on " << controlPath_ << ", hot upgrade disabled";
+        return;
+    }
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        LOG_SYSERR << "HotUpgrade::listen socket";
+        return;
+    }
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, controlPath_.c_str(), sizeof(addr.sun_path) - 1);
+    // 旧进程交接完成后不会删除路径，由后来者负责替换；上面已经确认没有别的服务器在使用它
+    ::unlink(controlPath_.c_str());
+    if (::bind(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0
+        || ::listen(fd, 1) < 0)
+    {
+        LOG_SYSERR << "HotUpgrade::listen " << controlPath_;
+        ::close(fd);
+        return;
+    }
+    listenFd_ = fd;
+    acceptThread_ = std::thread(&HotUpgrade::acceptThreadFunc, this);
+    LOG_INFO << "Hot upgrade control socket: " << controlPath_;
+}
+
+void HotUpgrade::acceptThreadFunc()
+{
+    while (true)
+    {
+        int listenFd = listenFd_.load();
+        if (listenFd < 0)
+        {
+            return; // 正在析构
+        }
+        int conn = ::accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (conn < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return; // 控制套接字被关闭
+        }
+
+        // 只是检查是否有服务器在运行的连接不会发送升级请求
+        char request = 0;
+        if (::read(conn, &request, 1) != 1 || request != kUpgradeRequest)
+        {
+            ::close(conn);
+            continue;
+        }
+
+        int fd = findSocket(true);
+        if (fd < 0 || !sendFd(conn, fd))
+        {
+            LOG_ERROR << "Failed to hand over listening socket";
+            ::close(conn);
+            continue;
+        }
+
+        // 等待新进程开始监听；新进程中途失败时连接会被关闭，此时继续服务
+        char ack = 0;
+        ssize_t n = ::read(conn, &ack, 1);
+        ::close(conn);
+        if (n != 1 || ack != 'R')
+        {
+            LOG_WARN << "New process aborted the upgrade, keep serving";
+            continue;
+        }
+
+        LOG_INFO << "Listening socket handed over, stop accepting";
+        if (listenFd_.exchange(-1) >= 0)
+        {
+            ::close(listenFd); // 不再接受后来的升级请求；已经换成-1时由析构函数关闭
+        }
+        handedOver_ = true;
+        if (handoffCallback_)
+        {
+            handoffCallback_();
+        }
+        return;
+    }
+}
+
+int HotUpgrade::findSocket(bool listening) const
+{
+    DIR* dir = ::opendir("/proc/self/fd");
+    if (!dir)
+    {
+        return -1;
+    }
+    int found = -1;
+    struct dirent* entry;
+    while (found < 0 && (entry = ::readdir(dir)) != nullptr)
+    {
+        char* end = nullptr;
+        long fd = strtol(entry->d_name, &end, 10);
+        if (*end != '\0' || end == entry->d_name || fd == ::dirfd(dir))
+        {
+            continue;
+        }
+        struct stat st;
+        if (::fstat(static_cast<int>(fd), &st) < 0 || !S_ISSOCK(st.st_mode))
+        {
+            continue;
+        }
+
+        int type = 0;
+        int acceptConn = 0;
+        socklen_t len = sizeof(type);
+        if (::getsockopt(static_cast<int>(fd), SOL_SOCKET, SO_TYPE, &type, &len) < 0 || type != SOCK_STREAM)
+        {
+            continue;
+        }
+        len = sizeof(acceptConn);
+        if (::getsockopt(static_cast<int>(fd), SOL_SOCKET, SO_ACCEPTCONN, &acceptConn, &len) < 0
+            || (acceptConn != 0) != listening)
+        {
+            continue;
+        }
+
+        struct sockaddr_storage addr;
+        len = sizeof(addr);
+        if (::getsockname(static_cast<int>(fd), reinterpret_cast<struct sockaddr*>(&addr), &len) < 0)
+        {
+            continue;
+        }
+        uint16_t port = 0;
+        if (addr.ss_family == AF_INET)
+        {
+            port = ntohs(reinterpret_cast<struct sockaddr_in*>(&addr)->sin_port);
+        }
+        else if (addr.ss_family == AF_INET6)
+        {
+            port = ntohs(reinterpret_cast<struct sockaddr_in6*>(&addr)->sin6_port);
+        }
+        if (port == port_)
+        {
+            found = static_cast<int>(fd);
+        }
+    }
+    ::closedir(dir);
+    return found;
+}
+
+bool HotUpgrade::sendFd(int sock, int fd)
+{
+    char byte = 'F';
+    struct iovec iov;
+    iov.iov_base = &byte;
+    iov.iov_len = 1;
+
+    char control[CMSG_SPACE(sizeof(int))];
+    memset(control, 0, sizeof(control));
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+
+    return ::sendmsg(sock, &msg, 0) == 1;
+}
+
+int HotUpgrade::recvFd(int sock)
+{
+    char byte = 0;
+    struct iovec iov;
+    iov.iov_base = &byte;
+    iov.iov_len = 1;
+
+    char control[CMSG_SPACE(sizeof(int))];
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    if (::recvmsg(sock, &msg, MSG_CMSG_CLOEXEC) != 1)
+    {
+        return -1;
+    }
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    if (!cmsg || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+    {
+        return -1;
+    }
+    int fd = -1;
+    memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+    return fd;
+}
+
+} // namespace http
@@ -20,6 +20,8 @@ bool HttpContext::parseRequest(Buffer *buf, Timestamp receiveTime)
                 if (ok)
                 {
                     request_.setReceiveTime(receiveTime);
+                    request_.setDeadline(muduo::addTime(receiveTime, requestTimeout_));
+                    request_.setRemoteAddr(remoteAddr_);
                     buf->retrieveUntil(crlf + 2);
                     state_ = kExpectHeaders;
                 }
@@ -31,6 +31,10 @@ bool HttpRequest::setMethod(const char* start, const char* end)
     {
         method_ = kDelete;
     }
+    else if(m == "OPTIONS")
+    {
+        method_ = kOptions; // CORS预检请求
+    }
     else
     {
         method_ = kInvalid;
@@ -38,6 +42,20 @@ bool HttpRequest::setMethod(const char* start, const char* end)
     return method_ != kInvalid;
 }
 
+const char* HttpRequest::methodString() const
+{
+    switch (method_)
+    {
+    case kGet:     return "GET";
+    case kPost:    return "POST";
+    case kHead:    return "HEAD";
+    case kPut:     return "PUT";
+    case kDelete:  return "DELETE";
+    case kOptions: return "OPTIONS";
+    default:       return "UNKNOWN";
+    }
+}
+
 void HttpRequest::setPath(const char* start, const char* end)
 {
     path_.assign(start, end);
@@ -50,6 +68,13 @@ void HttpRequest::setPathParameters(const std::string& key, const std::string& v
 
 std::string HttpRequest::getPathParameters(const std::string& key) const
 {
+    for (int i = 0; i < pathParamCount_; ++i)
+    {
+        if (pathParams_[i].name == key)
+        {
+            return path_.substr(pathParams_[i].offset, pathParams_[i].length);
+        }
+    }
     auto it = pathParameters_.find(key);
     if (it != pathParameters_.end())
     {
@@ -58,6 +83,37 @@ std::string HttpRequest::getPathParameters(const std::string& key) const
     return "";
 }
 
+bool HttpRequest::addPathParameter(std::string_view name, size_t offset, size_t length)
+{
+    if (pathParamCount_ >= kMaxPathParams || offset + length > path_.size())
+    {
+        return false;
+    }
+    pathParams_[pathParamCount_++] = PathParam{name, static_cast<uint32_t>(offset), static_cast<uint32_t>(length)};
+    return true;
+}
+
+std::string_view HttpRequest::pathParameter(std::string_view name) const
+{
+    for (int i = 0; i < pathParamCount_; ++i)
+    {
+        if (pathParams_[i].name == name)
+        {
+            return std::string_view(path_).substr(pathParams_[i].offset, pathParams_[i].length);
+        }
+    }
+    return std::string_view();
+}
+
+std::string_view HttpRequest::pathParameter(int index) const
+{
+    if (index < 0 || index >= pathParamCount_)
+    {
+        return std::string_view();
+    }
+    return std::string_view(path_).substr(pathParams_[index].offset, pathParams_[index].length);
+}
+
 std::string HttpRequest::getQueryParameters(const std::string& key) const
 {
     auto it = queryParameters_.find(key);
@@ -147,7 +203,15 @@ void HttpRequest::swap(HttpRequest& that)
     std::swap(version_, that.version_);
     std::swap(path_, that.path_);
     std::swap(receiveTime_, that.receiveTime_);
+    std::swap(deadline_, that.deadline_);
+    std::swap(traceId_, that.traceId_);
+    std::swap(remoteAddr_, that.remoteAddr_);
+    std::swap(session_, that.session_);
+    std::swap(contentLength_, that.contentLength_);
+    std::swap(content_, that.content_);
     std::swap(pathParameters_, that.pathParameters_);
+    std::swap(pathParams_, that.pathParams_);
+    std::swap(pathParamCount_, that.pathParamCount_);
     std::swap(queryParameters_, that.queryParameters_);
     std::swap(headers_, that.headers_);
 }
@@ -11,12 +11,19 @@ void HttpResponse::setStatusLine(HttpStatusCode statusCode
     statusMessage_ = statusMessage;
 }
 
+void HttpResponse::setGatewayTimeout(const std::string& version)
+{
+    *this = HttpResponse(true);
+    setStatusLine(k504GatewayTimeout, "Gateway Timeout", version);
+    setContentLength(0);
+}
+
 void HttpResponse::appendToBuffer(muduo::net::Buffer* output) const
 {
     char buf[32];
     // 把协议版本和状态码格式化
     // 之所以不格式化状态信息，是因为状态信息的大下不固定，可能会导致缓冲区溢出
-    snprintf(buf, sizeof(buf), "%s %d", httpVersion_.c_str(), statusCode_);
+    snprintf(buf, sizeof(buf), "%s %d ", httpVersion_.c_str(), statusCode_);
 
     output->append(buf); // 协议版本和状态码
     output->append(statusMessage_);// 状态信息
@@ -38,10 +45,30 @@ void HttpResponse::appendToBuffer(muduo::net::Buffer* output) const
         output->append(header.second);
         output->append("\r\n");
     }
+    output->append(rawHeaders_);
+    if (preformatted())
+    {
+        output->append(preformatted_.data(), preformatted_.size()); // 已经包含空行和响应体
+        return;
+    }
     output->append("\r\n");
 
     output->append(body_); // 请求体可能为空
+}
 
-
+std::string HttpResponse::formatHeadersAndBody() const
+{
+    std::string out;
+    for (auto& header : headers_)
+    {
+        out.append(header.first);
+        out.append(": ");
+        out.append(header.second);
+        out.append("\r\n");
+    }
+    out.append(rawHeaders_);
+    out.append("\r\n");
+    out.append(body_);
+    return out;
 }
 }
\ No newline at end of file
@@ -2,14 +2,30 @@
 #include <functional>
 #include <memory>
 #include <any>
+#include <thread>
 
 namespace http
 {
+struct HttpServer::Exchange
+{
+    Exchange(const muduo::net::TcpConnectionPtr& c, bool close) : conn(c), response(close) {}
+
+    muduo::net::TcpConnectionPtr conn;
+    HttpRequest req; // 从连接的HttpContext中换出来，处理期间连接可以继续接收数据
+    HttpResponse response;
+    bool dispatching = false; // 正在onRequest中同步执行
+    bool deadlineExceeded = false;
+    bool finished = false;
+    std::function<void()> cancelChain; // 没有走完中间件链就结束时通知已经进入的中间件
+    muduo::net::TimerId deadlineTimer; // 异步处理期间的截止时间定时器
+    bool timerArmed = false;
+};
+
 HttpServer::HttpServer(int port,
                        const std::string& name,
                        bool useSsL,
                        muduo::net::TcpServer::Option option)
-    : listenAddr_(port), server_(&mainLoop_, listenAddr_, name, option), useSsl_(useSsL),httpCallback_(std::bind(&HttpServer::handleRequest, this, std::placeholders::_1, std::placeholders::_2))
+    : listenAddr_(port), server_(&mainLoop_, listenAddr_, name, option), useSsl_(useSsL)
 {
     initialize();
 }
@@ -23,10 +39,129 @@ void HttpServer::initialize()
     
 }
 
+void HttpServer::setCpuAffinity(const CpuAffinityConfig& config)
+{
+    cpuAffinity_ = config;
+    if (cpuAffinity_.ioLoopCpus.empty())
+    {
+        return;
+    }
+    // 每个IO线程启动时在自己的线程里执行，此后该线程分配的缓冲区都在本地NUMA节点上
+    server_.setThreadInitCallback([this](muduo::net::EventLoop*) {
+        int index = nextIoLoop_++;
+        const std::vector<int>& cpus = cpuAffinity_.ioLoopCpus[index % cpuAffinity_.ioLoopCpus.size()];
+        if (CpuAffinity::pinCurrentThread(cpus))
+        {
+            LOG_INFO << "IO loop " << index << " pinned to " << cpus.size() << " cpu(s), first cpu " << cpus[0];
+        }
+    });
+}
+
 void HttpServer::start()
 {
+    middlewares_.compile();
+    for (auto& files : staticFiles_)
+    {
+        files->watch(&mainLoop_);
+    }
+    if (upgrade_ && takeOver_)
+    {
+        upgrade_->takeOver(); // 必须在server_开始listen之前替换套接字
+    }
+    else if (upgrade_ && upgrade_->running())
+    {
+        // 两个开启了热升级的进程都用SO_REUSEPORT，bind不会失败，只能在这里拒绝启动
+        LOG_FATAL << "Another server is running on " << upgrade_->controlPath() << ", take over from it instead";
+    }
     server_.start();
+    // 主循环运行在调用start()的线程上；IO线程在server_.start()中创建，会继承创建者的CPU掩码，
+    // 所以等它们启动之后再绑定主循环
+    CpuAffinity::pinCurrentThread(cpuAffinity_.acceptCpus);
+    if (upgrade_)
+    {
+        upgrade_->notifyReady();
+        // 交接完成后退出主循环，主循环只负责accept，已有连接仍由IO线程处理
+        upgrade_->listen([this]() { mainLoop_.quit(); });
+    }
     mainLoop_.loop(); // 启动事件循环
+    if (upgrade_ && upgrade_->handedOver())
+    {
+        drain();
+    }
+}
+
+std::shared_ptr<file::StaticFileServer> HttpServer::serveStatic(const std::string& urlPrefix, const std::string& root)
+{
+    auto files = std::make_shared<file::StaticFileServer>(root, urlPrefix);
+    files->load();
+    mountStatic(files);
+    return files;
+}
+
+std::shared_ptr<file::StaticFileServer> HttpServer::serveEmbedded(const std::string& urlPrefix,
+                                                                  const file::EmbeddedResourceTable& table)
+{
+    auto files = std::make_shared<file::StaticFileServer>("", urlPrefix);
+    files->loadEmbedded(table);
+    mountStatic(files);
+    return files;
+}
+
+void HttpServer::mountStatic(const std::shared_ptr<file::StaticFileServer>& files)
+{
+    router_.addDynamicCallback(HttpRequest::kGet, files->urlPrefix() + "/*path",
+        [files](const HttpRequest& req, HttpResponse* resp) {
+            if (!files->serveFile(std::string(req.pathParameter("path")), req, resp))
+            {
+                resp->setStatusLine(HttpResponse::k404NotFound, "Not Found", req.getVersion());
+                resp->setContentLength(0);
+            }
+        });
+    staticFiles_.push_back(files);
+}
+
+void HttpServer::enableHotUpgrade(const std::string& controlPath, bool takeOver, double drainTimeout)
+{
+    upgrade_ = std::make_unique<HotUpgrade>(controlPath, listenAddr_.port());
+    takeOver_ = takeOver;
+    drainTimeout_ = drainTimeout;
+}
+
+void HttpServer::drain()
+{
+    draining_ = true;
+    LOG_INFO << "Draining " << activeConns_.load() << " connections";
+
+    std::vector<muduo::net::TcpConnectionPtr> conns;
+    {
+        std::lock_guard<std::mutex> lock(connsMutex_);
+        for (auto& item : liveConns_)
+        {
+            if (auto conn = item.second.lock())
+            {
+                conns.push_back(conn);
+            }
+        }
+    }
+    // 空闲的长连接直接关闭，正在收发请求的连接在响应后由onRequest关闭
+    // 判断和关闭都放到连接所属的IO线程里执行，避免和正在处理的请求竞争
+    for (auto& conn : conns)
+    {
+        conn->getLoop()->runInLoop([conn]() {
+            HttpContext* context = boost::any_cast<HttpContext>(conn->getMutableContext());
+            if (context && context->idle() && conn->inputBuffer()->readableBytes() == 0)
+            {
+                conn->shutdown();
+            }
+        });
+    }
+
+    muduo::Timestamp deadline = muduo::addTime(muduo::Timestamp::now(), drainTimeout_);
+    while (activeConns_.load() > 0 && muduo::Timestamp::now() < deadline)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    LOG_INFO << "Drain finished, " << activeConns_.load() << " connections left";
 }
 
 // ssl配置：证书、证书链、私钥、协议版本、加密套件、客户端验证、验证深度、会话超时、会话缓存大小
@@ -55,10 +190,18 @@ void HttpServer::onConnection(const muduo::net::TcpConnectionPtr& conn)
             sslConns_[conn] = std::move(sslConn);
             sslConns_[conn]->startHandShake(); // 启动SSL握手
         }
-        conn->setContext(HttpContext()); // 为每个连接创建一个HttpContext对象
+        HttpContext context(requestTimeout_);
+        context.setRemoteAddr(conn->peerAddress().toIp());
+        conn->setContext(context); // 为每个连接创建一个HttpContext对象
+        ++activeConns_;
+        std::lock_guard<std::mutex> lock(connsMutex_);
+        liveConns_[conn->name()] = conn;
     }
     else{
         sslConns_.erase(conn);
+        --activeConns_;
+        std::lock_guard<std::mutex> lock(connsMutex_);
+        liveConns_.erase(conn->name());
     }
 }
 
@@ -71,19 +214,19 @@ void HttpServer::onMessage(const muduo::net::TcpConnectionPtr &conn,
         // 这层判断只是代表是否支持ssl
         if (useSsl_)
         {
-            LOG_INFO << "onMessage useSSL_ is true";
+            LOG_DEBUG << "onMessage useSSL_ is true";
             // 1.查找对应的SSL连接
             auto it = sslConns_.find(conn);
             if (it != sslConns_.end())
             {
-                LOG_INFO << "onMessage sslConns_ is not empty";
+                LOG_DEBUG << "onMessage sslConns_ is not empty";
                 // 2. SSL连接处理数据
                 it->second->onRead(conn, buf, receiveTime);
 
                 // 3. 如果 SSL 握手还未完成，直接返回
                 if (!it->second->isHandShakeCompleted())
                 {
-                    LOG_INFO << "onMessage sslConns_ is not empty";
+                    LOG_DEBUG << "onMessage sslConns_ is not empty";
                     return;
                 }
 
@@ -94,30 +237,45 @@ void HttpServer::onMessage(const muduo::net::TcpConnectionPtr &conn,
 
                 // 5. 使用解密后的数据进行HTTP 处理
                 buf = decryptedBuf; // 将 buf 指向解密后的数据
-                LOG_INFO << "onMessage decryptedBuf is not empty";
+                LOG_DEBUG << "onMessage decryptedBuf is not empty";
             }
         }
-        // HttpContext对象用于解析出buf中的请求报文，并把报文的关键信息封装到HttpRequest对象中
-        HttpContext *context = boost::any_cast<HttpContext>(conn->getMutableContext());
+        processBuffer(conn, buf, receiveTime);
+    }
+    catch (const std::exception &e)
+    {
+        // 捕获异常，返回错误信息
+        LOG_ERROR << "Exception in onMessage: " << e.what();
+        conn->send("HTTP/1.1 400 Bad Request\r\n\r\n");
+        conn->shutdown();
+    }
+}
+
+void HttpServer::processBuffer(const muduo::net::TcpConnectionPtr& conn,
+                               muduo::net::Buffer* buf,
+                               muduo::Timestamp receiveTime)
+{
+    // HttpContext对象用于解析出buf中的请求报文，并把报文的关键信息封装到HttpRequest对象中
+    HttpContext *context = boost::any_cast<HttpContext>(conn->getMutableContext());
+    while (!context->pending() && buf->readableBytes() > 0)
+    {
         if (!context->parseRequest(buf, receiveTime)) // 解析一个http请求
         {
             // 如果解析http报文过程中出错
             conn->send("HTTP/1.1 400 Bad Request\r\n\r\n");
             conn->shutdown();
+            return;
         }
         // 如果buf缓冲区中解析出一个完整的数据包才封装响应报文
-        if (context->gotAll())
+        if (!context->gotAll())
         {
-            onRequest(conn, context->request());
-            context->reset();
+            return;
+        }
+        onRequest(conn, context);
+        if (!conn->connected())
+        {
+            return; // 响应后关闭了连接，后面的数据不再处理
         }
-    }
-    catch (const std::exception &e)
-    {
-        // 捕获异常，返回错误信息
-        LOG_ERROR << "Exception in onMessage: " << e.what();
-        conn->send("HTTP/1.1 400 Bad Request\r\n\r\n");
-        conn->shutdown();
     }
 }
 // void HttpServer::onMessage(const muduo::net::TcpConnectionPtr& conn,
@@ -173,71 +331,228 @@ void HttpServer::onMessage(const muduo::net::TcpConnectionPtr &conn,
     
 // }
 
-void HttpServer::onRequest(const muduo::net::TcpConnectionPtr &conn, const HttpRequest &req)
+void HttpServer::onRequest(const muduo::net::TcpConnectionPtr &conn, HttpContext* context)
 {
-    const std::string& connection = req.getHeader("Connection");
+    const HttpRequest& parsed = context->request();
+    const std::string& connection = parsed.getHeader("Connection");
     // 如果请求的connection字段为close或者HTTP版本为1.0且connection字段为Keep-Alive
     bool close = connection == "close" ||
-                 (req.getVersion() == "HTTP/1.0" && connection != "Keep-Alive");
-    HttpResponse response(close); // 封装response
-    httpCallback_(req, &response); // 处理请求
+                 (parsed.getVersion() == "HTTP/1.0" && connection != "Keep-Alive");
+    auto ex = std::make_shared<Exchange>(conn, close); // 封装response
+    ex->req.swap(context->request());
+    context->reset();
+    context->setPending(true);
 
-    // 如果使用SSL，加密后发送响应
-    if (useSsl_)
+    // 按采样率决定是否追踪这个请求，解析的耗时从收到数据开始算
+    trace::Tracer& tracer = trace::Tracer::getInstance();
+    ex->req.setTraceId(tracer.sample());
+    tracer.record("http", "parse", ex->req.traceId(), ex->req.receiveTime(), muduo::Timestamp::now());
+
+    ex->dispatching = true;
+    if (httpCallback_)
     {
-        auto it = sslConns_.find(conn);
-        if (it!= sslConns_.end())
-        {
-            // 获取相应的长度
-            size_t responseLength = response.getContentLength();
-            it->second->send(&response, responseLength);
-            if (response.closeConnection())
+        runStep(ex, [this, ex]() {
+            httpCallback_(ex->req, &ex->response); // 处理请求
+            finishRequest(ex);
+        });
+    }
+    else
+    {
+        runStep(ex, [this, ex]() { handleRequest(ex); });
+    }
+    ex->dispatching = false;
+
+    // 还在异步处理的请求到截止时间时直接返回504，之后才到达的结果被丢弃
+    if (!ex->finished && ex->req.deadline().valid())
+    {
+        std::weak_ptr<Exchange> weak(ex);
+        ex->deadlineTimer = conn->getLoop()->runAt(ex->req.deadline(), [this, weak]() {
+            ExchangePtr ex = weak.lock();
+            if (ex && !ex->finished)
             {
-                conn->shutdown();
+                ex->timerArmed = false;
+                ex->deadlineExceeded = true;
+                finishRequest(ex);
             }
-            return;
+        });
+        ex->timerArmed = true;
+    }
+}
+
+void HttpServer::handleRequest(const ExchangePtr& ex)
+{
+    // 处理完成的通知可能来自别的线程，回到IO线程再发送响应
+    auto finish = [this, ex]() {
+        ex->conn->getLoop()->runInLoop([this, ex]() { finishRequest(ex); });
+    };
+    auto dispatch = [this, ex](const std::function<void()>& done) {
+        // 路由处理
+        if (!router_.route(ex->req, &ex->response, done))
+        {
+            // 路由失败，返回404错误
+            ex->response.setStatusCode(HttpResponse::k404NotFound);
+            ex->response.setStatusMessage("Not Found");
+            ex->response.setCloseConnection(true);
+            done();
         }
+    };
+
+    // 中间件链处理，直接修改请求
+    // 中间件已经给出响应（如预检请求、限流、缓存命中）时不再路由
+    const middleware::MiddlewareChain& chain = middlewares_.select(ex->req.path());
+    if (chain.empty())
+    {
+        dispatch(finish);
+    }
+    else
+    {
+        auto post = [this, ex](std::function<void()> step) { runStep(ex, step); };
+        chain.process(ex->req, ex->response, post, dispatch, finish, &ex->cancelChain);
     }
+}
 
-    muduo::net::Buffer buf;
-    response.appendToBuffer(&buf);// 将response放入发送缓冲区
-    conn->send(&buf); // 发送响应
-    if (response.closeConnection())
+void HttpServer::runStep(const ExchangePtr& ex, const std::function<void()>& step)
+{
+    ex->conn->getLoop()->runInLoop([this, ex, step]() {
+        if (ex->finished)
+        {
+            return; // 已经因为超时或异常提前结束了
+        }
+        // 处理期间的数据库等待、查询和AI搜索都以这个截止时间为准
+        Deadline::Scope deadline(ex->req.deadline());
+        trace::Tracer::Scope trace(ex->req.traceId());
+        try
+        {
+            // 在缓冲区里等太久，或者等异步结果等太久的请求直接放弃
+            Deadline::check();
+            step();
+        }
+        catch (const DeadlineExceeded&)
+        {
+            ex->deadlineExceeded = true;
+            finishRequest(ex);
+        }
+        catch(const std::exception& e)
+        {
+            LOG_ERROR << "Exception in HttpServer::handleRequest:" << e.what();
+            ex->response.setStatusCode(HttpResponse::k500InternalServerError);
+            ex->response.setStatusMessage("Internal Server Error");
+            finishRequest(ex);
+        }
+        if (deadline.exceeded())
+        {
+            ex->deadlineExceeded = true;
+        }
+    });
+}
+
+void HttpServer::finishRequest(const ExchangePtr& ex)
+{
+    if (ex->finished)
     {
-        conn->shutdown();
+        return;
+    }
+    ex->finished = true;
+    if (ex->timerArmed)
+    {
+        ex->conn->getLoop()->cancel(ex->deadlineTimer);
+        ex->timerArmed = false;
+    }
+    // 异常或超时时中间件的after不会执行，让它们释放before中占用的资源（如缓存的single-flight）
+    // 取消函数引用着Exchange，用完清掉
+    if (ex->cancelChain)
+    {
+        std::function<void()> cancel;
+        cancel.swap(ex->cancelChain);
+        cancel();
+    }
+
+    // 处理器可能自己捕获了超时异常并写了别的响应，这里以超时为准
+    if (ex->deadlineExceeded || Deadline::exceeded())
+    {
+        LOG_WARN << "Request deadline exceeded: " << ex->req.path();
+        ex->response.setGatewayTimeout(ex->req.getVersion());
+    }
+    // 会话的修改在响应发出之前写入，客户端的下一个请求一定能看到
+    if (sessionManager_ && ex->req.session())
+    {
+        try
+        {
+            sessionManager_->commit(ex->req, &ex->response);
+        }
+        catch (const std::exception& e)
+        {
+            LOG_ERROR << "Session commit failed: " << e.what();
+        }
+    }
+    const muduo::net::TcpConnectionPtr& conn = ex->conn;
+    sendResponse(conn, ex->req, ex->response);
+    if (ex->req.traceId())
+    {
+        trace::Tracer::getInstance().record("http", "request", ex->req.traceId(), ex->req.receiveTime(),
+                                            muduo::Timestamp::now(), std::string(ex->req.methodString()) + " " + ex->req.path());
     }
 
+    HttpContext* context = boost::any_cast<HttpContext>(conn->getMutableContext());
+    context->setPending(false);
+    // 同步完成时由processBuffer的循环继续解析，异步完成时在这里继续解析处理期间到达的数据
+    if (!ex->dispatching && conn->connected() && !ex->response.closeConnection())
+    {
+        try
+        {
+            processBuffer(conn, requestBuffer(conn), muduo::Timestamp::now());
+        }
+        catch (const std::exception &e)
+        {
+            LOG_ERROR << "Exception in finishRequest: " << e.what();
+            conn->send("HTTP/1.1 400 Bad Request\r\n\r\n");
+            conn->shutdown();
+        }
+    }
 }
 
-void HttpServer::handleRequest(const HttpRequest &req, HttpResponse *resp)
+void HttpServer::sendResponse(const muduo::net::TcpConnectionPtr& conn, const HttpRequest& req, HttpResponse& response)
 {
-    try
+    if (draining_.load(std::memory_order_relaxed))
     {
-        // 中间件链处理
-        HttpRequest mutableReq = req;
-        middlewareChain_.processBefore(mutableReq);
+        response.setCloseConnection(true); // 排空期间处理完就关闭，处理器设置的keep-alive也不再生效
+    }
 
-        // 路由处理
-        if (!router_.route(mutableReq, resp))
+    muduo::net::Buffer buf;
+    response.appendToBuffer(&buf);// 将response放入发送缓冲区
+    logging::AccessLogger::getInstance().log(req, response, buf.readableBytes());
+
+    // 如果使用SSL，加密序列化后的响应再发送
+    bool sent = false;
+    if (useSsl_)
+    {
+        auto it = sslConns_.find(conn);
+        if (it!= sslConns_.end())
         {
-            // 路由失败，返回404错误
-            resp->setStatusCode(HttpResponse::k404NotFound);
-            resp->setStatusMessage("Not Found");
-            resp->setCloseConnection(true);
+            it->second->send(buf.peek(), buf.readableBytes());
+            sent = true;
         }
-        
-        middlewareChain_.processAfter(*resp);
     }
-    catch (const HttpResponse& res)
+    if (!sent)
     {
-        *resp = res;// 捕获到预检问请求的响应，直接返回
+        conn->send(&buf); // 发送响应
     }
-    catch(const std::exception& e)
+    if (response.closeConnection())
     {
-        LOG_ERROR << "Exception in HttpServer::handleRequest:" << e.what();
-        resp->setStatusCode(HttpResponse::k500InternalServerError);
-        resp->setStatusMessage("Internal Server Error");
+        conn->shutdown();
     }
-    
 }
-}
\ No newline at end of file
+
+muduo::net::Buffer* HttpServer::requestBuffer(const muduo::net::TcpConnectionPtr& conn)
+{
+    if (useSsl_)
+    {
+        auto it = sslConns_.find(conn);
+        if (it != sslConns_.end())
+        {
+            return it->second->getDecryptedBuffer();
+        }
+    }
+    return conn->inputBuffer();
+}
+}
@@ -0,0 +1,224 @@
+#include "../../include/http/LoadAwareTcpServer.h"
+#include <muduo/base/Logging.h>
+
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+namespace http
+{
+namespace
+{
+int createListenSocket(const muduo::net::InetAddress& listenAddr, bool reusePort)
+{
+    int fd = ::socket(listenAddr.family(), SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_TCP);
+    if (fd < 0)
+    {
+        LOG_SYSFATAL << "LoadAwareTcpServer socket";
+    }
+    int on = 1;
+    ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    if (reusePort)
+    {
+        ::setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+    }
+    socklen_t len = listenAddr.family() == AF_INET6 ? sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in);
+    if (::bind(fd, listenAddr.getSockAddr(), len) < 0)
+    {
+        LOG_SYSFATAL << "LoadAwareTcpServer bind " << listenAddr.toIpPort();
+    }
+    return fd;
+}
+} // namespace
+
+LoadAwareTcpServer::LoadAwareTcpServer(muduo::net::EventLoop* loop,
+                                       const muduo::net::InetAddress& listenAddr,
+                                       const std::string& name,
+                                       muduo::net::TcpServer::Option option)
+    : loop_(loop)
+    , name_(name)
+    , ipPort_(listenAddr.toIpPort())
+    , listenFd_(createListenSocket(listenAddr, option == muduo::net::TcpServer::kReusePort))
+    , idleFd_(::open("/dev/null", O_RDONLY | O_CLOEXEC))
+    , acceptChannel_(loop, listenFd_)
+    , threadPool_(new muduo::net::EventLoopThreadPool(loop, name))
+    , started_(false)
+    , nextConnId_(1)
+{
+    acceptChannel_.setReadCallback([this](muduo::Timestamp) { handleRead(); });
+}
+
+LoadAwareTcpServer::~LoadAwareTcpServer()
+{
+    for (auto& item : connections_)
+    {
+        muduo::net::TcpConnectionPtr conn(item.second);
+        item.second.reset();
+        conn->getLoop()->runInLoop(std::bind(&muduo::net::TcpConnection::connectDestroyed, conn));
+    }
+    if (started_)
+    {
+        loop_->cancel(probeTimer_);
+        acceptChannel_.disableAll();
+        acceptChannel_.remove();
+    }
+    ::close(listenFd_);
+    ::close(idleFd_);
+}
+
+void LoadAwareTcpServer::setThreadNum(int numThreads)
+{
+    threadPool_->setThreadNum(numThreads);
+}
+
+void LoadAwareTcpServer::start()
+{
+    if (started_)
+    {
+        return;
+    }
+    started_ = true;
+    threadPool_->start(threadInitCallback_);
+    // 没有IO线程时所有连接都在主循环上
+    for (muduo::net::EventLoop* ioLoop : threadPool_->getAllLoops())
+    {
+        auto load = std::make_unique<LoopLoad>();
+        load->loop = ioLoop;
+        loadOfLoop_[ioLoop] = load.get();
+        loads_.push_back(std::move(load));
+    }
+
+    if (::listen(listenFd_, SOMAXCONN) < 0)
+    {
+        LOG_SYSFATAL << "LoadAwareTcpServer listen " << ipPort_;
+    }
+    acceptChannel_.enableReading();
+    probeTimer_ = loop_->runEvery(kProbeInterval, [this]() { probeLoops(); });
+}
+
+void LoadAwareTcpServer::handleRead()
+{
+    struct sockaddr_in6 addr;
+    memset(&addr, 0, sizeof(addr));
+    socklen_t len = sizeof(addr);
+    int connfd = ::accept4(listenFd_, reinterpret_cast<struct sockaddr*>(&addr), &len,
+                           SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (connfd >= 0)
+    {
+        newConnection(connfd, muduo::net::InetAddress(addr));
+        return;
+    }
+
+    LOG_SYSERR << "LoadAwareTcpServer accept";
+    if (errno == EMFILE)
+    {
+        // 文件描述符耗尽：临时释放预留的fd，接受并立即关闭这个连接，避免监听套接字一直可读造成忙循环
+        ::close(idleFd_);
+        idleFd_ = ::accept(listenFd_, nullptr, nullptr);
+        ::close(idleFd_);
+        idleFd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+    }
+}
+
+void LoadAwareTcpServer::newConnection(int sockfd, const muduo::net::InetAddress& peerAddr)
+{
+    LoopLoad* load = pickLoop();
+    muduo::net::EventLoop* ioLoop = load->loop;
+
+    char buf[64];
+    snprintf(buf, sizeof(buf), "-%s#%d", ipPort_.c_str(), nextConnId_);
+    ++nextConnId_;
+    std::string connName = name_ + buf;
+
+    struct sockaddr_in6 local;
+    memset(&local, 0, sizeof(local));
+    socklen_t len = sizeof(local);
+    if (::getsockname(sockfd, reinterpret_cast<struct sockaddr*>(&local), &len) < 0)
+    {
+        LOG_SYSERR << "LoadAwareTcpServer getsockname";
+    }
+
+    LOG_DEBUG << "LoadAwareTcpServer::newConnection [" << name_ << "] - new connection [" << connName
+              << "] from " << peerAddr.toIpPort() << ", loop load " << load->connections.load();
+
+    muduo::net::TcpConnectionPtr conn(new muduo::net::TcpConnection(ioLoop, connName, sockfd,
+                                                                    muduo::net::InetAddress(local), peerAddr));
+    connections_[connName] = conn;
+    load->connections++;
+    conn->setConnectionCallback(connectionCallback_);
+    conn->setMessageCallback(messageCallback_);
+    conn->setWriteCompleteCallback(writeCompleteCallback_);
+    conn->setCloseCallback([this](const muduo::net::TcpConnectionPtr& c) { removeConnection(c); });
+    ioLoop->runInLoop(std::bind(&muduo::net::TcpConnection::connectEstablished, conn));
+}
+
+void LoadAwareTcpServer::removeConnection(const muduo::net::TcpConnectionPtr& conn)
+{
+    // 在IO线程中被调用，转到主循环中修改connections_
+    loop_->runInLoop([this, conn]() { removeConnectionInLoop(conn); });
+}
+
+void LoadAwareTcpServer::removeConnectionInLoop(const muduo::net::TcpConnectionPtr& conn)
+{
+    connections_.erase(conn->name());
+    muduo::net::EventLoop* ioLoop = conn->getLoop();
+    auto it = loadOfLoop_.find(ioLoop);
+    if (it != loadOfLoop_.end())
+    {
+        it->second->connections--;
+    }
+    ioLoop->queueInLoop(std::bind(&muduo::net::TcpConnection::connectDestroyed, conn));
+}
+
+LoadAwareTcpServer::LoopLoad* LoadAwareTcpServer::pickLoop()
+{
+    int64_t now = muduo::Timestamp::now().microSecondsSinceEpoch();
+    LoopLoad* best = nullptr;
+    int64_t bestScore = 0;
+    // 从上一次选择之后的位置开始找，负载相同时依次分配
+    size_t n = loads_.size();
+    for (size_t i = 0; i < n; ++i)
+    {
+        LoopLoad* load = loads_[(nextConnId_ + i) % n].get();
+        int64_t lagUs = load->lagUs.load(std::memory_order_relaxed);
+        int64_t posted = load->probePostedUs.load(std::memory_order_relaxed);
+        if (posted != 0 && now - posted > lagUs)
+        {
+            lagUs = now - posted; // 探测任务迟迟没有执行，说明这个线程现在正忙
+        }
+        int64_t score = load->connections.load(std::memory_order_relaxed) + lagUs / 1000 * kLagWeight;
+        if (!best || score < bestScore)
+        {
+            best = load;
+            bestScore = score;
+        }
+    }
+    return best;
+}
+
+void LoadAwareTcpServer::probeLoops()
+{
+    int64_t now = muduo::Timestamp::now().microSecondsSinceEpoch();
+    for (auto& item : loads_)
+    {
+        LoopLoad* load = item.get();
+        int64_t expected = 0;
+        // 上一个探测任务还没执行就不再投递
+        if (!load->probePostedUs.compare_exchange_strong(expected, now))
+        {
+            continue;
+        }
+        load->loop->queueInLoop([load]() {
+            int64_t posted = load->probePostedUs.load();
+            load->lagUs.store(muduo::Timestamp::now().microSecondsSinceEpoch() - posted);
+            load->probePostedUs.store(0);
+        });
+    }
+}
+
+} // namespace http
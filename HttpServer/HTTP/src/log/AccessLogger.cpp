@@ -0,0 +1,151 @@
+#include "../../include/log/AccessLogger.h"
+#include <muduo/base/Logging.h>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+
+namespace http
+{
+namespace logging
+{
+bool AccessLogBuffer::append(const HttpRequest& req, const HttpResponse& resp, int64_t latencyUs, size_t bytes)
+{
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) >= kSlots)
+    {
+        // 后台线程来不及消费，丢弃这条日志而不是阻塞IO线程
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    Slot& slot = slots_[tail & (kSlots - 1)];
+    muduo::Timestamp receiveTime = req.receiveTime();
+    time_t seconds = receiveTime.secondsSinceEpoch();
+    int micros = static_cast<int>(receiveTime.microSecondsSinceEpoch() % muduo::Timestamp::kMicroSecondsPerSecond);
+    struct tm tmTime;
+    gmtime_r(&seconds, &tmTime);
+
+    // 直接格式化到槽位里，不产生任何堆分配
+    int n = snprintf(slot.data, kLineSize, "%4d%02d%02d %02d:%02d:%02d.%06d %s %s %d %lldus %zu\n",
+                     tmTime.tm_year + 1900, tmTime.tm_mon + 1, tmTime.tm_mday,
+                     tmTime.tm_hour, tmTime.tm_min, tmTime.tm_sec, micros,
+                     req.methodString(), req.path().c_str(),
+                     static_cast<int>(resp.getStatusCode()),
+                     static_cast<long long>(latencyUs), bytes);
+    if (n < 0)
+    {
+        return false;
+    }
+    if (n >= static_cast<int>(kLineSize))
+    {
+        // 被截断的行也要以换行结尾
+        n = kLineSize - 1;
+        slot.data[n - 1] = '\n';
+    }
+    slot.len = n;
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+AccessLogger::~AccessLogger()
+{
+    stop();
+}
+
+void AccessLogger::start(const std::string& basename, off_t rollSize, int flushIntervalMs)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (running_.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+    flushIntervalMs_ = flushIntervalMs;
+    // AsyncLogging自带后台写文件线程，这里的刷盘线程只负责把各IO线程的缓冲区搬过去
+    asyncLog_ = std::make_unique<muduo::AsyncLogging>(basename, rollSize);
+    asyncLog_->start();
+    running_.store(true, std::memory_order_release);
+    flushThread_ = std::thread(&AccessLogger::flushThreadFunc, this);
+    LOG_INFO << "Access log started, basename: " << basename;
+}
+
+void AccessLogger::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_.load(std::memory_order_relaxed))
+        {
+            return;
+        }
+        running_.store(false, std::memory_order_release);
+    }
+    cv_.notify_one();
+    if (flushThread_.joinable())
+    {
+        flushThread_.join();
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        drainAll(); // 收集最后一批日志
+    }
+    asyncLog_->stop();
+}
+
+void AccessLogger::log(const HttpRequest& req, const HttpResponse& resp, size_t bytes)
+{
+    if (!running_.load(std::memory_order_acquire))
+    {
+        return;
+    }
+    int64_t latencyUs = muduo::Timestamp::now().microSecondsSinceEpoch()
+                        - req.receiveTime().microSecondsSinceEpoch();
+    threadBuffer()->append(req, resp, latencyUs, bytes);
+}
+
+uint64_t AccessLogger::dropped() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint64_t total = 0;
+    for (const auto& buffer : buffers_)
+    {
+        total += buffer->dropped();
+    }
+    return total;
+}
+
+AccessLogBuffer* AccessLogger::threadBuffer()
+{
+    // 每个线程只在第一次记录日志时加一次锁
+    thread_local AccessLogBuffer* buffer = nullptr;
+    if (!buffer)
+    {
+        auto newBuffer = std::make_unique<AccessLogBuffer>();
+        buffer = newBuffer.get();
+        std::lock_guard<std::mutex> lock(mutex_);
+        buffers_.push_back(std::move(newBuffer));
+    }
+    return buffer;
+}
+
+void AccessLogger::flushThreadFunc()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (running_.load(std::memory_order_acquire))
+    {
+        cv_.wait_for(lock, std::chrono::milliseconds(flushIntervalMs_));
+        drainAll();
+    }
+}
+
+// 调用者需持有mutex_
+void AccessLogger::drainAll()
+{
+    for (auto& buffer : buffers_)
+    {
+        buffer->drain([this](const char* line, int len) {
+            asyncLog_->append(line, len);
+        });
+    }
+}
+
+} // namespace logging
+} // namespace http
@@ -1,40 +1,148 @@
 #include "../../include/middlerWare/MiddlewareChain.h"
+#include "../../include/trace/Tracer.h"
 #include <muduo/base/Logging.h>
 
 namespace http
 {
 namespace middleware
 {
+struct MiddlewareChain::Run
+{
+    const MiddlewareChain* chain;
+    HttpRequest* req;
+    HttpResponse* resp;
+    Executor post;
+    Handler handler;
+    std::function<void()> done;
+    size_t passed = 0; // 已经放行的中间件个数
+    bool pending = false; // 第passed个中间件正在等待resume
+    bool completed = false; // 已经开始after或者已经取消
+    muduo::Timestamp pendingSince; // 当前中间件开始等待的时间
+};
+
 void MiddlewareChain::addMiddleware(std::shared_ptr<Middleware> middleware)
 {
     middlewares_.push_back(middleware);
 }
 
-void MiddlewareChain::processBefore(HttpRequest& req)
+void MiddlewareChain::process(HttpRequest& req, HttpResponse& resp, const Executor& post,
+                              const Handler& handler, const std::function<void()>& done,
+                              std::function<void()>* cancel) const
 {
-    for (size_t i = 0; i < middlewares_.size(); ++i)
+    auto run = std::make_shared<Run>();
+    run->chain = this;
+    run->req = &req;
+    run->resp = &resp;
+    run->post = post;
+    run->handler = handler;
+    run->done = done;
+    if (cancel)
     {
-        middlewares_[i]->before(req);
+        // 前几个中间件的before就可能抛出异常，所以先交出取消函数
+        *cancel = [run]() { MiddlewareChain::cancel(run); };
     }
+    runBefore(run);
 }
 
-void MiddlewareChain::processAfter(HttpResponse &response)
+void MiddlewareChain::runBefore(const std::shared_ptr<Run>& run)
 {
+    const std::vector<std::shared_ptr<Middleware>>& middlewares = run->chain->middlewares_;
+    while (run->passed < middlewares.size())
+    {
+        Middleware::Resume resume = [run](Middleware::Action action) {
+            run->post([run, action]() { resumeBefore(run, action); });
+        };
+        Middleware::Action action;
+        {
+            trace::Span span("middleware.before", middlewares[run->passed]->name());
+            action = middlewares[run->passed]->beforeAsync(*run->req, *run->resp, resume);
+        }
+        if (action == Middleware::kPending)
+        {
+            run->pending = true;
+            if (trace::Tracer::current())
+            {
+                run->pendingSince = muduo::Timestamp::now();
+            }
+            return; // 由resume继续
+        }
+        if (action == Middleware::kRespond)
+        {
+            runAfter(run);
+            return;
+        }
+        ++run->passed;
+    }
+    run->handler([run]() {
+        run->post([run]() { runAfter(run); });
+    });
+}
+
+void MiddlewareChain::resumeBefore(const std::shared_ptr<Run>& run, Middleware::Action action)
+{
+    if (run->completed)
+    {
+        return; // 等待期间请求已经结束
+    }
+    run->pending = false;
+    // 等待异步结果的时间
+    trace::Tracer::getInstance().record("middleware.pending", run->chain->middlewares_[run->passed]->name(),
+                                        trace::Tracer::current(), run->pendingSince, muduo::Timestamp::now());
+    if (action == Middleware::kContinue)
+    {
+        ++run->passed;
+        runBefore(run);
+    }
+    else
+    {
+        runAfter(run);
+    }
+}
+
+void MiddlewareChain::runAfter(const std::shared_ptr<Run>& run)
+{
+    if (run->completed)
+    {
+        return; // 处理器完成之前请求已经取消
+    }
+    run->completed = true;
+    const std::vector<std::shared_ptr<Middleware>>& middlewares = run->chain->middlewares_;
     try
     {
         // 反向处理响应，以保持中间件的正确执行顺序
-        for (auto it = middlewares_.rbegin(); it != middlewares_.rend(); ++it)
+        for (size_t i = run->passed; i > 0; --i)
         {
-            if (*it)
-            { // 添加空指针检查
-                (*it)->after(response);
-            }
+            trace::Span span("middleware.after", middlewares[i - 1]->name());
+            middlewares[i - 1]->after(*run->req, *run->resp);
         }
     }
     catch (const std::exception &e)
     {
         LOG_ERROR << "Error in middleware after processing: " << e.what();
     }
+    run->done();
+}
+
+void MiddlewareChain::cancel(const std::shared_ptr<Run>& run)
+{
+    if (run->completed)
+    {
+        return;
+    }
+    run->completed = true;
+    const std::vector<std::shared_ptr<Middleware>>& middlewares = run->chain->middlewares_;
+    size_t entered = run->passed + (run->pending ? 1 : 0);
+    for (size_t i = entered; i > 0; --i)
+    {
+        try
+        {
+            middlewares[i - 1]->cancel(*run->req);
+        }
+        catch (const std::exception &e)
+        {
+            LOG_ERROR << "Error in middleware cancel: " << e.what();
+        }
+    }
 }
 }
 }
\ No newline at end of file
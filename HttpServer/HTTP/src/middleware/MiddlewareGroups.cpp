@@ -0,0 +1,125 @@
+#include "../../include/middlerWare/MiddlewareGroups.h"
+#include <algorithm>
+#include <muduo/base/Logging.h>
+
+namespace http
+{
+namespace middleware
+{
+void MiddlewareGroups::addGlobal(std::shared_ptr<Middleware> middleware)
+{
+    if (compiled_)
+    {
+        LOG_ERROR << "MiddlewareGroups::addGlobal called after compile, ignored";
+        return;
+    }
+    global_.push_back(std::move(middleware));
+}
+
+void MiddlewareGroups::addToGroup(const std::string& prefix, std::shared_ptr<Middleware> middleware)
+{
+    if (compiled_)
+    {
+        LOG_ERROR << "MiddlewareGroups::addToGroup called after compile, ignored";
+        return;
+    }
+    Group* group = findGroup(prefix);
+    if (!group)
+    {
+        global_.push_back(std::move(middleware));
+        return;
+    }
+    group->middlewares.push_back(std::move(middleware));
+}
+
+void MiddlewareGroups::addOuterToGroup(const std::string& prefix, std::shared_ptr<Middleware> middleware)
+{
+    if (compiled_)
+    {
+        LOG_ERROR << "MiddlewareGroups::addOuterToGroup called after compile, ignored";
+        return;
+    }
+    Group* group = findGroup(prefix);
+    if (!group)
+    {
+        global_.insert(global_.begin(), std::move(middleware));
+        return;
+    }
+    group->outer.push_back(std::move(middleware));
+}
+
+MiddlewareGroups::Group* MiddlewareGroups::findGroup(const std::string& prefix)
+{
+    // 统一去掉末尾的斜杠，"/"或空前缀等同于全局
+    std::string normalized = prefix;
+    while (!normalized.empty() && normalized.back() == '/')
+    {
+        normalized.pop_back();
+    }
+    if (normalized.empty())
+    {
+        return nullptr;
+    }
+
+    auto it = std::find_if(groups_.begin(), groups_.end(),
+                           [&normalized](const Group& group) { return group.prefix == normalized; });
+    if (it == groups_.end())
+    {
+        groups_.push_back(Group{normalized, {}, {}, MiddlewareChain()});
+        it = groups_.end() - 1;
+    }
+    return &*it;
+}
+
+void MiddlewareGroups::compile()
+{
+    if (compiled_)
+    {
+        return;
+    }
+    compiled_ = true;
+
+    for (const auto& middleware : global_)
+    {
+        globalChain_.addMiddleware(middleware);
+    }
+    for (auto& group : groups_)
+    {
+        // 分组外层的中间件最先执行，然后是全局中间件，分组中间件在最后
+        for (const auto& middleware : group.outer)
+        {
+            group.chain.addMiddleware(middleware);
+        }
+        for (const auto& middleware : global_)
+        {
+            group.chain.addMiddleware(middleware);
+        }
+        for (const auto& middleware : group.middlewares)
+        {
+            group.chain.addMiddleware(middleware);
+        }
+    }
+    std::stable_sort(groups_.begin(), groups_.end(), [](const Group& a, const Group& b) {
+        return a.prefix.size() > b.prefix.size();
+    });
+}
+
+const MiddlewareChain& MiddlewareGroups::select(const std::string& path) const
+{
+    for (const auto& group : groups_)
+    {
+        if (matchPrefix(path, group.prefix))
+        {
+            return group.chain;
+        }
+    }
+    return globalChain_;
+}
+
+bool MiddlewareGroups::matchPrefix(const std::string& path, const std::string& prefix)
+{
+    return path.compare(0, prefix.size(), prefix) == 0
+        && (path.size() == prefix.size() || path[prefix.size()] == '/');
+}
+}
+}
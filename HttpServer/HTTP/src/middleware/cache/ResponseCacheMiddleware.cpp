@@ -0,0 +1,246 @@
+#include "../../../include/middlerWare/cache/ResponseCacheMiddleware.h"
+#include <algorithm>
+#include <muduo/base/Logging.h>
+
+namespace http
+{
+namespace middleware
+{
+ResponseCacheMiddleware::ResponseCacheMiddleware(size_t maxBytes)
+    : maxBytes_(maxBytes)
+    , bytes_(0)
+    , hits_(0)
+    , misses_(0)
+    , coalesced_(0)
+    , evictions_(0)
+{}
+
+void ResponseCacheMiddleware::cacheRoute(const std::string& path, double ttl, const std::vector<std::string>& vary)
+{
+    rules_[path] = RouteRule{ttl, vary};
+}
+
+void ResponseCacheMiddleware::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    lru_.clear();
+    index_.clear();
+    bytes_ = 0;
+}
+
+ResponseCacheMiddleware::Stats ResponseCacheMiddleware::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return Stats{hits_.load(), misses_.load(), coalesced_.load(), evictions_.load(), index_.size(), bytes_};
+}
+
+Middleware::Action ResponseCacheMiddleware::before(HttpRequest& req, HttpResponse& resp)
+{
+    return beforeAsync(req, resp, Resume());
+}
+
+Middleware::Action ResponseCacheMiddleware::beforeAsync(HttpRequest& req, HttpResponse& resp, const Resume& resume)
+{
+    const RouteRule* rule = findRule(req);
+    if (!rule)
+    {
+        return kContinue;
+    }
+    std::string key = makeKey(req, *rule);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (lookupLocked(key, req, resp))
+    {
+        hits_.fetch_add(1, std::memory_order_relaxed);
+        return kRespond;
+    }
+    if (!resume)
+    {
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        return kContinue;
+    }
+
+    // 没有命中：没有人在计算就自己计算，否则挂起，由计算的请求完成时唤醒
+    auto it = flights_.find(key);
+    if (it == flights_.end())
+    {
+        flights_.emplace(key, Flight{&req, {}});
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        return kContinue;
+    }
+    it->second.waiters.push_back(Waiter{&req, &resp, resume});
+    coalesced_.fetch_add(1, std::memory_order_relaxed);
+    return kPending;
+}
+
+void ResponseCacheMiddleware::after(const HttpRequest& req, HttpResponse& resp)
+{
+    const RouteRule* rule = findRule(req);
+    if (!rule)
+    {
+        return;
+    }
+    std::string key = makeKey(req, *rule);
+
+    // 只缓存成功的、不带会话Cookie的响应
+    bool cacheable = !resp.preformatted() && resp.getStatusCode() == HttpResponse::k200Ok &&
+                     !resp.hasHeader("Set-Cookie");
+    Entry entry;
+    if (cacheable)
+    {
+        entry.key = key;
+        entry.statusCode = resp.getStatusCode();
+        entry.statusMessage = resp.statusMessage();
+        entry.headersAndBody = std::make_shared<const std::string>(resp.formatHeadersAndBody());
+        entry.expireAt = muduo::addTime(muduo::Timestamp::now(), rule->ttl);
+    }
+
+    std::vector<Waiter> waiters;
+    std::vector<Action> actions;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (cacheable)
+        {
+            insertLocked(std::move(entry));
+        }
+        auto it = flights_.find(key);
+        if (it == flights_.end() || it->second.leader != &req)
+        {
+            return; // 不是这个键上计算的请求
+        }
+        waiters.swap(it->second.waiters);
+        flights_.erase(it);
+        // 在锁内写入等待的请求的响应：它超时结束时先通过cancel拿锁，不会和这里同时访问resp
+        for (Waiter& waiter : waiters)
+        {
+            actions.push_back(lookupLocked(key, *waiter.req, *waiter.resp) ? kRespond : kContinue);
+        }
+    }
+    // 结果不能缓存时等待的请求各自计算
+    for (size_t i = 0; i < waiters.size(); ++i)
+    {
+        (actions[i] == kRespond ? hits_ : misses_).fetch_add(1, std::memory_order_relaxed);
+        waiters[i].resume(actions[i]);
+    }
+}
+
+void ResponseCacheMiddleware::cancel(const HttpRequest& req)
+{
+    const RouteRule* rule = findRule(req);
+    if (!rule)
+    {
+        return;
+    }
+    std::string key = makeKey(req, *rule);
+
+    Resume next;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = flights_.find(key);
+        if (it == flights_.end())
+        {
+            return;
+        }
+        Flight& flight = it->second;
+        if (flight.leader != &req)
+        {
+            // 挂起等待的请求自己超时了，不再唤醒它
+            auto waiter = std::find_if(flight.waiters.begin(), flight.waiters.end(),
+                                       [&req](const Waiter& w) { return w.req == &req; });
+            if (waiter != flight.waiters.end())
+            {
+                flight.waiters.erase(waiter);
+            }
+            return;
+        }
+        if (flight.waiters.empty())
+        {
+            flights_.erase(it);
+            return;
+        }
+        // 计算的请求异常或超时结束，由等待最久的请求接着计算，其余的继续等
+        flight.leader = flight.waiters.front().req;
+        next = std::move(flight.waiters.front().resume);
+        flight.waiters.erase(flight.waiters.begin());
+    }
+    misses_.fetch_add(1, std::memory_order_relaxed);
+    next(kContinue);
+}
+
+const ResponseCacheMiddleware::RouteRule* ResponseCacheMiddleware::findRule(const HttpRequest& req) const
+{
+    if (req.method() != HttpRequest::kGet)
+    {
+        return nullptr;
+    }
+    auto it = rules_.find(req.path());
+    return it == rules_.end() ? nullptr : &it->second;
+}
+
+std::string ResponseCacheMiddleware::makeKey(const HttpRequest& req, const RouteRule& rule)
+{
+    std::string key = req.methodString();
+    key += ' ';
+    key += req.path();
+    const auto& headers = req.headers();
+    for (const std::string& name : rule.vary)
+    {
+        key += '\n';
+        auto it = headers.find(name);
+        if (it != headers.end())
+        {
+            key += it->second;
+        }
+    }
+    return key;
+}
+
+bool ResponseCacheMiddleware::lookupLocked(const std::string& key, const HttpRequest& req, HttpResponse& resp)
+{
+    auto it = index_.find(key);
+    if (it == index_.end())
+    {
+        return false;
+    }
+    std::list<Entry>::iterator entry = it->second;
+    if (entry->expireAt < muduo::Timestamp::now())
+    {
+        bytes_ -= entry->headersAndBody->size();
+        lru_.erase(entry);
+        index_.erase(it);
+        return false;
+    }
+    lru_.splice(lru_.begin(), lru_, entry);
+    resp.setStatusLine(entry->statusCode, entry->statusMessage, req.getVersion());
+    resp.setPreformatted(entry->headersAndBody);
+    return true;
+}
+
+void ResponseCacheMiddleware::insertLocked(Entry entry)
+{
+    size_t size = entry.headersAndBody->size();
+    if (size > maxBytes_)
+    {
+        return;
+    }
+    auto it = index_.find(entry.key);
+    if (it != index_.end())
+    {
+        bytes_ -= it->second->headersAndBody->size();
+        lru_.erase(it->second);
+        index_.erase(it);
+    }
+    while (bytes_ + size > maxBytes_ && !lru_.empty())
+    {
+        bytes_ -= lru_.back().headersAndBody->size();
+        index_.erase(lru_.back().key);
+        lru_.pop_back();
+        evictions_.fetch_add(1, std::memory_order_relaxed);
+    }
+    lru_.push_front(std::move(entry));
+    index_[lru_.front().key] = lru_.begin();
+    bytes_ += size;
+}
+
+}
+}
@@ -8,45 +8,62 @@ namespace http
 {
 namespace middleware
 {
-CorsMiddleware::CorsMiddleware(const CorsConfig& config) : config_(config) {}
+CorsMiddleware::CorsMiddleware(const CorsConfig& config)
+    : config_(config)
+    , allowAllOrigins_(false)
+    , allowedOrigins_(config.allowedOrigins.begin(), config.allowedOrigins.end())
+{
+    allowAllOrigins_ = config_.allowedOrigins.empty() || allowedOrigins_.count("*") > 0;
+
+    if (config_.allowCredentials)
+    {
+        commonHeaders_ += "Access-Control-Allow-Credentials: true\r\n";
+    }
+    if (!config_.allowedMethod.empty())
+    {
+        commonHeaders_ += "Access-Control-Allow-Methods: " + join(config_.allowedMethod, ", ") + "\r\n";
+    }
+    if (!config_.allowedHeaders.empty())
+    {
+        commonHeaders_ += "Access-Control-Allow-Headers: " + join(config_.allowedHeaders, ", ") + "\r\n";
+    }
+    // 设置预检请求的缓存时间
+    commonHeaders_ += "Access-Control-Max-Age: " + std::to_string(config_.maxAge) + "\r\n";
+
+    if (!config_.allowedOrigins.empty())
+    {
+        // 如果在源中发现了通配符*，说明允许所有源，否则使用第一个允许的源
+        std::string origin = allowedOrigins_.count("*") ? "*" : config_.allowedOrigins[0];
+        responseHeaders_ = "Access-Control-Allow-Origin: " + origin + "\r\n" + commonHeaders_;
+    }
+}
 
-void CorsMiddleware::before(HttpRequest& req)
+Middleware::Action CorsMiddleware::before(HttpRequest& req, HttpResponse& resp)
 {
     LOG_DEBUG << "CorsMiddleware::before - Processing request";
 
     if (req.method() == HttpRequest::Method::kOptions)
     {
-        LOG_INFO << "Processing CORS preflight request";// 日志记录这是一个预检请求
-        HttpResponse response;
-        handlePrefightRequest(req, response);
-        throw response;// 
+        LOG_DEBUG << "Processing CORS preflight request";// 日志记录这是一个预检请求
+        handlePrefightRequest(req, resp); // 直接写入最终的响应
+        return kRespond;
     }
+    return kContinue;
 }
 
-void CorsMiddleware::after(HttpResponse& resp)
+void CorsMiddleware::after(const HttpRequest& req, HttpResponse& resp)
 {
     LOG_DEBUG << "CorsMiddleware::after - Processing response";
-    if (!config_.allowedOrigins.empty())
+    if (!responseHeaders_.empty())
     {
-        // 如果在源中发现了通配符*，说明允许所有源
-        if (std::find(config_.allowedOrigins.begin(), config_.allowedOrigins.end(), "*")
-                != config_.allowedOrigins.end())
-        {
-            addCorsHeaders(resp, "*");
-        }
-        else
-        {
-            // 添加第一个允许的源
-            addCorsHeaders(resp, config_.allowedOrigins[0]);
-        }
+        resp.appendRawHeaders(responseHeaders_);
     }
 }
 
 // 判断是否允许使用当前源
 bool CorsMiddleware::isOrigrinAllowed(const std::string& origin) const
 {
-    return config_.allowedOrigins.empty() || std::find(config_.allowedOrigins.begin(), config_.allowedOrigins.end(), "*") != config_.allowedOrigins.end() ||
-            std::find(config_.allowedOrigins.begin(), config_.allowedOrigins.end(), origin) != config_.allowedOrigins.end(); 
+    return allowAllOrigins_ || allowedOrigins_.count(origin) > 0;
 }
 
 //
@@ -59,40 +76,20 @@ void CorsMiddleware::handlePrefightRequest(const HttpRequest& req, HttpResponse&
     {
         LOG_WARN << "Origin is not allowed" << origin;
         // 请求的资源被禁止访问返回状态码403
-        resp.setStatusCode(HttpResponse::k403Forbidden);// 属于客户端错误
+        resp.setStatusLine(HttpResponse::k403Forbidden, "Forbidden", req.getVersion());// 属于客户端错误
+        resp.setContentLength(0); // 没有响应体，keep-alive连接上客户端才知道响应到哪里结束
         return;
     }
     addCorsHeaders(resp, origin);// 把可以访问的源构建在响应头中告诉客户端
-    resp.setStatusCode(HttpResponse::k204NoContent);// 响应成功但是没有响应主体
-    LOG_INFO << "Preflight request processed sucessfully";
+    resp.setStatusLine(HttpResponse::k204NoContent, "No Content", req.getVersion());// 响应成功但是没有响应主体
+    LOG_DEBUG << "Preflight request processed sucessfully";
 
 }
 
 void CorsMiddleware::addCorsHeaders(HttpResponse& resp, const std::string& origin)
 {
-    try
-    {
-        resp.addHeader("Access-Control-Allow-Origin", origin);
-        if (config_.allowCredentials)
-        {
-            resp.addHeader("Access-Control-Allow-Credentials", "true");
-        }
-        if (!config_.allowedMethod.empty())
-        {
-            resp.addHeader("Access-Control-Allow-Methods", join(config_.allowedMethod, ", "));
-        }
-        if (!config_.allowedHeaders.empty())
-        {
-            resp.addHeader("Access-Control-Allow-Headers", join(config_.allowedHeaders, ", "));
-        }
-        // 设置预检请求的缓存时间
-        resp.addHeader("Access-Control-Max-Age", std::to_string(config_.maxAge));
-        LOG_DEBUG << "Cors headers added successfully";
-    }
-    catch (const std::exception& e)
-    {
-        LOG_ERROR << "Error adding CORS headers:" << e.what();
-    }
+    resp.addHeader("Access-Control-Allow-Origin", origin);
+    resp.appendRawHeaders(commonHeaders_);
 }
 
 std::string CorsMiddleware::join(const std::vector<std::string>& strings, const std::string& delimiter)
@@ -0,0 +1,190 @@
+#include "../../../include/middlerWare/ratelimit/RateLimitMiddleware.h"
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+#include <muduo/base/Logging.h>
+
+namespace http
+{
+namespace middleware
+{
+RateLimitMiddleware::RateLimitMiddleware(const RateLimitPolicy& defaultPolicy)
+    : sessionManager_(nullptr)
+    , rejected_(0)
+{
+    policies_.push_back(makeState(defaultPolicy));
+}
+
+void RateLimitMiddleware::addRoutePolicy(const std::string& path, const RateLimitPolicy& policy)
+{
+    policies_.push_back(makeState(policy));
+    routePolicies_[path] = policies_.back().get();
+}
+
+void RateLimitMiddleware::startExpiry(muduo::net::EventLoop* loop, double interval)
+{
+    loop->runEvery(interval, [this]() { expire(); });
+}
+
+Middleware::Action RateLimitMiddleware::before(HttpRequest& req, HttpResponse& resp)
+{
+    int64_t now = muduo::Timestamp::now().microSecondsSinceEpoch();
+    // 先检查更严格的路由策略，被它拒绝的请求不再消耗默认策略的令牌
+    // 被默认策略拒绝时把已经取走的路由令牌退回去，没有放行的请求两边都不消耗
+    PolicyState* state = nullptr;
+    PolicyState* route = nullptr;
+    std::string routeKey;
+    auto it = routePolicies_.find(req.path());
+    if (it != routePolicies_.end())
+    {
+        route = it->second;
+        routeKey = clientKey(route->policy, req);
+    }
+    if (route && !allow(*route, routeKey, now))
+    {
+        state = route;
+    }
+    else if (!allow(*policies_[0], clientKey(policies_[0]->policy, req), now))
+    {
+        state = policies_[0].get();
+        if (route)
+        {
+            refund(*route, routeKey);
+        }
+    }
+    if (!state)
+    {
+        return kContinue;
+    }
+
+    rejected_.fetch_add(1, std::memory_order_relaxed);
+    LOG_DEBUG << "Rate limited " << req.remoteAddr() << " " << req.path();
+    resp.setStatusLine(HttpResponse::k429TooManyRequests, "Too Many Requests", req.getVersion());
+    resp.setPreformatted(state->rejectBody);
+    return kRespond;
+}
+
+std::unique_ptr<RateLimitMiddleware::PolicyState> RateLimitMiddleware::makeState(const RateLimitPolicy& policy)
+{
+    auto state = std::make_unique<PolicyState>();
+    state->policy = policy;
+    double rate = policy.ratePerSecond > 0 ? policy.ratePerSecond : 1;
+    state->intervalUs = std::max<int64_t>(1, static_cast<int64_t>(1000000 / rate));
+    state->burstUs = state->intervalUs * std::max(1, policy.burst);
+
+    // 被拒绝后大约等一个令牌的时间再重试
+    int retryAfter = std::max(1, static_cast<int>(std::ceil(1 / rate)));
+    const std::string body = "Too Many Requests";
+    state->rejectBody = std::make_shared<const std::string>(
+        "Content-Type: text/plain\r\n"
+        "Content-Length: " + std::to_string(body.size()) + "\r\n"
+        "Retry-After: " + std::to_string(retryAfter) + "\r\n"
+        "\r\n" + body);
+    return state;
+}
+
+std::string RateLimitMiddleware::clientKey(const RateLimitPolicy& policy, const HttpRequest& req) const
+{
+    if (policy.keyExtractor)
+    {
+        std::string key = policy.keyExtractor(req);
+        if (!key.empty())
+        {
+            return key;
+        }
+    }
+    if (policy.key == RateLimitPolicy::kSessionId && sessionManager_)
+    {
+        // 只认存储里存在的会话，客户端随意伪造的sessionId拿不到新的桶
+        std::shared_ptr<session::Session> session = sessionManager_->findSession(req);
+        if (session)
+        {
+            return session->getId();
+        }
+    }
+    return req.remoteAddr();
+}
+
+// GCRA：桶的状态是下一次请求的理论到达时间tat
+// 取一个令牌就是把tat向后推一个间隔，推过之后超出当前时间一个桶容量以上说明令牌用完了
+bool RateLimitMiddleware::take(Bucket& bucket, const PolicyState& state, int64_t now)
+{
+    int64_t tat = bucket.tat.load(std::memory_order_relaxed);
+    while (true)
+    {
+        int64_t newTat = std::max(tat, now) + state.intervalUs;
+        if (newTat - now > state.burstUs)
+        {
+            return false;
+        }
+        if (bucket.tat.compare_exchange_weak(tat, newTat, std::memory_order_relaxed))
+        {
+            return true;
+        }
+    }
+}
+
+// 把tat往回拨一个间隔，和取令牌一样只是一次原子操作，和其他线程同时取令牌的顺序无关
+void RateLimitMiddleware::refund(PolicyState& state, const std::string& key)
+{
+    Shard& shard = state.shards[std::hash<std::string>{}(key) % kShardCount];
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    auto it = shard.buckets.find(key);
+    if (it != shard.buckets.end())
+    {
+        it->second->tat.fetch_sub(state.intervalUs, std::memory_order_relaxed);
+    }
+}
+
+bool RateLimitMiddleware::allow(PolicyState& state, const std::string& key, int64_t now)
+{
+    Shard& shard = state.shards[std::hash<std::string>{}(key) % kShardCount];
+    {
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        auto it = shard.buckets.find(key);
+        if (it != shard.buckets.end())
+        {
+            return take(*it->second, state, now);
+        }
+    }
+
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    std::unique_ptr<Bucket>& bucket = shard.buckets[key];
+    if (!bucket)
+    {
+        bucket = std::make_unique<Bucket>();
+    }
+    return take(*bucket, state, now);
+}
+
+void RateLimitMiddleware::expire()
+{
+    int64_t now = muduo::Timestamp::now().microSecondsSinceEpoch();
+    size_t removed = 0;
+    for (auto& state : policies_)
+    {
+        for (Shard& shard : state->shards)
+        {
+            std::unique_lock<std::shared_mutex> lock(shard.mutex);
+            for (auto it = shard.buckets.begin(); it != shard.buckets.end();)
+            {
+                if (it->second->tat.load(std::memory_order_relaxed) <= now)
+                {
+                    it = shard.buckets.erase(it);
+                    ++removed;
+                }
+                else
+                {
+                    ++it;
+                }
+            }
+        }
+    }
+    if (removed > 0)
+    {
+        LOG_DEBUG << "RateLimitMiddleware expired " << removed << " buckets";
+    }
+}
+
+}
+}
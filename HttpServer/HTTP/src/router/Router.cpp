@@ -1,78 +1,301 @@
 #include "../../include/router/Router.h"
+#include "../../include/trace/Tracer.h"
 #include <muduo/base/Logging.h>
+#include <stdexcept>
 
 namespace http
 {
 namespace router
 {
+namespace
+{
+// 同步的处理器在handleAsync里面就会调用done，done会继续执行中间件的after并写出响应，
+// 处理器的span要在这之前结束；异步的处理器只记录交出去之前的部分
+void handleTraced(RouterHandler& handler, HttpRequest& req, HttpResponse* resp, const RouterHandler::Done& done)
+{
+    if (!trace::Tracer::current())
+    {
+        handler.handleAsync(req, resp, done); // 没有采样时不多分配
+        return;
+    }
+    auto span = std::make_shared<trace::Span>("router", "handler");
+    handler.handleAsync(req, resp, [span, done]() {
+        span->end();
+        done();
+    });
+    span->end();
+}
+} // namespace
+
 void Router::registerHandler(HttpRequest::Method method, const std::string& path, HandlerPtr handler)
 {
+    int index = findStatic(method, path);
+    if (index >= 0)
+    {
+        staticRoutes_[index].handler = std::move(handler);
+        staticRoutes_[index].callback = nullptr;
+        return;
+    }
     RouterKey key{method, path};
     handlers_[key] = std::move(handler); // 内部自动生成hashcode
 }
 
 void Router::registerCallBack(HttpRequest::Method method, const std::string& path, const HandlerCallback &callback)
 {
+    int index = findStatic(method, path);
+    if (index >= 0)
+    {
+        staticRoutes_[index].handler.reset();
+        staticRoutes_[index].callback = callback;
+        return;
+    }
     RouterKey key{method, path};
     callbacks_[key] = std::move(callback); // 把callback转移到value
 }
 
 // 执行回调
-bool Router::route(const HttpRequest& req, HttpResponse* resp)
+bool Router::route(HttpRequest& req, HttpResponse* resp, const RouterHandler::Done& done)
 {
+    trace::Span span("router", "match");
+    // 编译期路由表：一次哈希一次比较
+    int index = findStatic(req.method(), req.path());
+    if (index >= 0 && !staticRoutes_[index].empty())
+    {
+        span.end();
+        invoke(staticRoutes_[index], req, resp, done);
+        return true;
+    }
+
     RouterKey key{req.method(), req.path()}; // 在表里进行匹配
 
     // 先去匹配处理器
     auto handlerIt = handlers_.find(key);
     if (handlerIt != handlers_.end())
     {
-        handlerIt->second->handle(req, resp); // value（处理器）->执行
+        span.end();
+        handleTraced(*handlerIt->second, req, resp, done); // value（处理器）->执行
         return true;
     }
     //否则执行回调
     auto callbackIt = callbacks_.find(key);
     if (callbackIt != callbacks_.end())
     {
+        span.end();
+        trace::Span handlerSpan("router", "handler");
         callbackIt->second(req, resp);
+        handlerSpan.end();
+        done();
         return true; 
     }
 
-    // 如果是不是静态， 查找动态路由处理器
-    for  (const auto &[method, pathRegex, handler] : regexHandlers_)
+    // 如果不是静态路由，在动态路由树中查找
+    const std::unique_ptr<Node>& root = trees_[req.method()];
+    if (!root)
+    {
+        return false;
+    }
+    size_t offsets[HttpRequest::kMaxPathParams];
+    size_t lengths[HttpRequest::kMaxPathParams];
+    const Route* target = matchRoute(root.get(), req.path(), 0, offsets, lengths, 0);
+    if (!target)
+    {
+        return false;
+    }
+
+    // 参数只记录在路径中的位置，不拷贝请求对象，也不分配内存
+    req.clearPathParameters();
+    for (size_t i = 0; i < target->paramNames.size(); ++i)
+    {
+        req.addPathParameter(target->paramNames[i], offsets[i], lengths[i]);
+    }
+    span.end();
+    invoke(*target, req, resp, done);
+    return true;
+}
+
+void Router::invoke(const Route& target, HttpRequest& req, HttpResponse* resp, const RouterHandler::Done& done)
+{
+    if (target.handler)
     {
-        std::smatch match;
-        std::string pathStr(req.path());
-        // 检查方法匹配不匹配，然后检查路径参数是否和正则表达式匹配，这就是动态路由匹配的过程
-        // 类似于静态路由匹配，只不过静态路由匹配方法和路径，动态路由检查方法和路径参数
-        // 如果pathStr和pathRegex匹配，就会填充match对象，就可以提取参数
-        if (method == req.method() && std::regex_match(pathStr, match, pathRegex))
+        handleTraced(*target.handler, req, resp, done);
+    }
+    else
+    {
+        trace::Span span("router", "handler");
+        target.callback(req, resp);
+        span.end();
+        done();
+    }
+}
+
+void Router::addDynamicHandler(HttpRequest::Method method, const std::string& path, HandlerPtr handler)
+{
+    Route& route = insertRoute(method, path);
+    route.handler = std::move(handler);
+    route.callback = nullptr;
+}
+
+void Router::addDynamicCallback(HttpRequest::Method method, const std::string& path, const HandlerCallback& callback)
+{
+    Route& route = insertRoute(method, path);
+    route.handler.reset();
+    route.callback = callback;
+}
+
+Router::Route& Router::insertRoute(HttpRequest::Method method, const std::string& path)
+{
+    std::unique_ptr<Node>& root = trees_[method];
+    if (!root)
+    {
+        root = std::make_unique<Node>();
+    }
+
+    Node* node = root.get();
+    std::vector<std::string> paramNames;
+    size_t i = 0;
+    while (i < path.size())
+    {
+        bool segmentStart = i > 0 && path[i - 1] == '/';
+        if (segmentStart && path[i] == ':')
         {
-            HttpRequest newReq(req);
-            // 原来的req的路径参数还没有封装完成，匹配之后重新封装，这样才是一个完整的请求对象
-            extractPathParameters(match, newReq);
+            size_t end = path.find('/', i);
+            if (end == std::string::npos)
+            {
+                end = path.size();
+            }
+            paramNames.push_back(path.substr(i + 1, end - i - 1));
+            if (!node->paramChild)
+            {
+                node->paramChild = std::make_unique<Node>();
+            }
+            node = node->paramChild.get();
+            i = end;
+            continue;
+        }
+        if (segmentStart && path[i] == '*')
+        {
+            // 通配匹配剩余的全部路径，后面不能再有别的片段
+            std::string name = path.substr(i + 1);
+            paramNames.push_back(name.empty() ? "*" : name);
+            if (!node->wildcardChild)
+            {
+                node->wildcardChild = std::make_unique<Node>();
+            }
+            node = node->wildcardChild.get();
+            break;
+        }
+
+        // 静态片段，一直到下一个参数或通配为止
+        size_t end = i + 1;
+        while (end < path.size() && !(path[end - 1] == '/' && (path[end] == ':' || path[end] == '*')))
+        {
+            ++end;
+        }
+        std::string segment = path.substr(i, end - i);
+        while (!segment.empty())
+        {
+            size_t idx = node->indices.find(segment[0]);
+            if (idx == std::string::npos)
+            {
+                auto child = std::make_unique<Node>();
+                child->prefix = segment;
+                node->indices.push_back(segment[0]);
+                node->children.push_back(std::move(child));
+                node = node->children.back().get();
+                break;
+            }
 
-            handler->handle(newReq, resp);
-            return true;
+            Node* child = node->children[idx].get();
+            size_t common = 0;
+            while (common < child->prefix.size() && common < segment.size()
+                   && child->prefix[common] == segment[common])
+            {
+                ++common;
+            }
+            if (common < child->prefix.size())
+            {
+                // 只有一部分公共前缀，把原来的子节点拆成两段
+                auto mid = std::make_unique<Node>();
+                mid->prefix = child->prefix.substr(0, common);
+                std::unique_ptr<Node> rest = std::move(node->children[idx]);
+                rest->prefix.erase(0, common);
+                mid->indices.push_back(rest->prefix[0]);
+                mid->children.push_back(std::move(rest));
+                node->children[idx] = std::move(mid);
+                child = node->children[idx].get();
+            }
+            node = child;
+            segment.erase(0, common);
         }
+        i = end;
     }
-    // 否则，查动态路由回调
-    for (const auto& [method, pathRegex, callback] : regexCallbacks_)
+
+    if (paramNames.size() > static_cast<size_t>(HttpRequest::kMaxPathParams))
     {
-        std::smatch match;
-        std::string pathStr(req.path());
-        if ( method == req.method() && std::regex_match(pathStr, match, pathRegex))
+        throw std::invalid_argument("too many path parameters in route: " + path);
+    }
+    if (!node->route.empty())
+    {
+        LOG_WARN << "Route " << path << " registered twice, the later one wins";
+    }
+    node->route.paramNames = std::move(paramNames);
+    return node->route;
+}
+
+// 在node下匹配path[pos, end)，depth为已经捕获的参数个数
+// 静态子节点的首字符互不相同，所以每一层最多只需要比较一个静态子节点
+const Router::Route* Router::matchRoute(const Node* node, const std::string& path, size_t pos,
+                                        size_t* offsets, size_t* lengths, int depth) const
+{
+    if (pos == path.size() && !node->route.empty())
+    {
+        return &node->route;
+    }
+
+    if (pos < path.size())
+    {
+        size_t idx = node->indices.find(path[pos]);
+        if (idx != std::string::npos)
         {
-            // 提取路径参数
-            HttpRequest newReq(req);
-            extractPathParameters(match, newReq);
+            const Node* child = node->children[idx].get();
+            if (path.compare(pos, child->prefix.size(), child->prefix) == 0)
+            {
+                const Route* found = matchRoute(child, path, pos + child->prefix.size(), offsets, lengths, depth);
+                if (found)
+                {
+                    return found;
+                }
+            }
+        }
 
-            callback(newReq, resp);
-            return true;
+        if (node->paramChild && depth < HttpRequest::kMaxPathParams)
+        {
+            size_t end = path.find('/', pos);
+            if (end == std::string::npos)
+            {
+                end = path.size();
+            }
+            if (end > pos)
+            {
+                offsets[depth] = pos;
+                lengths[depth] = end - pos;
+                const Route* found = matchRoute(node->paramChild.get(), path, end, offsets, lengths, depth + 1);
+                if (found)
+                {
+                    return found;
+                }
+            }
         }
+    }
 
+    if (node->wildcardChild && !node->wildcardChild->route.empty() && depth < HttpRequest::kMaxPathParams)
+    {
+        offsets[depth] = pos;
+        lengths[depth] = path.size() - pos;
+        return &node->wildcardChild->route;
     }
-    return false;
+    return nullptr;
 }
 
-}
-}
\ No newline at end of file
+} // namespace router
+} // namespace http
@@ -0,0 +1,402 @@
+#include "../../include/session/CookieSessionStorage.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
+
+namespace http
+{
+namespace session
+{
+namespace
+{
+const char kBase64Url[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+// cookie中不能出现 + / =，所以用base64url并且不补齐
+std::string encodeBase64Url(const std::string& in)
+{
+    std::string out;
+    out.reserve((in.size() * 4 + 2) / 3);
+    size_t i = 0;
+    for (; i + 2 < in.size(); i += 3)
+    {
+        uint32_t n = (static_cast<uint8_t>(in[i]) << 16) | (static_cast<uint8_t>(in[i + 1]) << 8)
+                   | static_cast<uint8_t>(in[i + 2]);
+        out.push_back(kBase64Url[(n >> 18) & 63]);
+        out.push_back(kBase64Url[(n >> 12) & 63]);
+        out.push_back(kBase64Url[(n >> 6) & 63]);
+        out.push_back(kBase64Url[n & 63]);
+    }
+    if (i + 1 == in.size())
+    {
+        uint32_t n = static_cast<uint8_t>(in[i]) << 16;
+        out.push_back(kBase64Url[(n >> 18) & 63]);
+        out.push_back(kBase64Url[(n >> 12) & 63]);
+    }
+    else if (i + 2 == in.size())
+    {
+        uint32_t n = (static_cast<uint8_t>(in[i]) << 16) | (static_cast<uint8_t>(in[i + 1]) << 8);
+        out.push_back(kBase64Url[(n >> 18) & 63]);
+        out.push_back(kBase64Url[(n >> 12) & 63]);
+        out.push_back(kBase64Url[(n >> 6) & 63]);
+    }
+    return out;
+}
+
+int base64UrlValue(char c)
+{
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '-') return 62;
+    if (c == '_') return 63;
+    return -1;
+}
+
+bool decodeBase64Url(const std::string& in, std::string* out)
+{
+    if (in.size() % 4 == 1)
+    {
+        return false;
+    }
+    out->clear();
+    out->reserve(in.size() * 3 / 4);
+    uint32_t n = 0;
+    int bits = 0;
+    for (char c : in)
+    {
+        int v = base64UrlValue(c);
+        if (v < 0)
+        {
+            return false;
+        }
+        n = (n << 6) | static_cast<uint32_t>(v);
+        bits += 6;
+        if (bits >= 8)
+        {
+            bits -= 8;
+            out->push_back(static_cast<char>((n >> bits) & 0xff));
+        }
+    }
+    return true;
+}
+
+// 跨机器共享cookie，整数按大端写入
+void putUint(std::string& out, uint64_t v, int bytes)
+{
+    for (int i = bytes - 1; i >= 0; --i)
+    {
+        out.push_back(static_cast<char>((v >> (i * 8)) & 0xff));
+    }
+}
+
+// 按顺序读取数据，越界后ok()为false
+class Reader
+{
+public:
+    Reader(const char* data, size_t size) : data_(data), size_(size), pos_(0), ok_(true) {}
+
+    uint64_t uint(int bytes)
+    {
+        if (!ok_ || size_ - pos_ < static_cast<size_t>(bytes))
+        {
+            ok_ = false;
+            return 0;
+        }
+        uint64_t v = 0;
+        for (int i = 0; i < bytes; ++i)
+        {
+            v = (v << 8) | static_cast<uint8_t>(data_[pos_++]);
+        }
+        return v;
+    }
+
+    std::string bytes(size_t n)
+    {
+        if (!ok_ || size_ - pos_ < n)
+        {
+            ok_ = false;
+            return std::string();
+        }
+        std::string s(data_ + pos_, n);
+        pos_ += n;
+        return s;
+    }
+
+    bool ok() const { return ok_; }
+    bool done() const { return pos_ == size_; }
+
+private:
+    const char* data_;
+    size_t size_;
+    size_t pos_;
+    bool ok_;
+};
+
+void hmacSha256(const void* key, size_t keyLen, const void* data, size_t len, unsigned char* out)
+{
+    unsigned int outLen = 0;
+    HMAC(EVP_sha256(), key, static_cast<int>(keyLen), static_cast<const unsigned char*>(data), len, out, &outLen);
+}
+
+int64_t nowMs()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+} // namespace
+
+CookieSessionStorage::CookieSessionStorage(const std::vector<Key>& keys, bool encrypt)
+    : encrypt_(encrypt)
+{
+    if (keys.empty())
+    {
+        throw std::invalid_argument("cookie session storage needs at least one key");
+    }
+    for (const Key& key : keys)
+    {
+        if (key.secret.size() < kMinSecretBytes)
+        {
+            throw std::invalid_argument("cookie session key " + std::to_string(key.id) + " is too short");
+        }
+        if (findKey(key.id))
+        {
+            throw std::invalid_argument("duplicate cookie session key id " + std::to_string(key.id));
+        }
+        DerivedKey derived;
+        derived.id = key.id;
+        static const char kMacLabel[] = "http-session-mac";
+        static const char kEncLabel[] = "http-session-enc";
+        hmacSha256(key.secret.data(), key.secret.size(), kMacLabel, sizeof(kMacLabel) - 1, derived.macKey);
+        hmacSha256(key.secret.data(), key.secret.size(), kEncLabel, sizeof(kEncLabel) - 1, derived.encKey);
+        keys_.push_back(derived);
+    }
+}
+
+std::vector<CookieSessionStorage::Key> CookieSessionStorage::loadKeys(const std::string& path)
+{
+    std::ifstream in(path);
+    if (!in)
+    {
+        throw std::runtime_error("cannot open session key file " + path);
+    }
+    std::vector<Key> keys;
+    std::string line;
+    while (std::getline(in, line))
+    {
+        if (line.empty() || line[0] == '#')
+        {
+            continue;
+        }
+        std::istringstream fields(line);
+        int id = -1;
+        std::string secret;
+        if (!(fields >> id >> secret) || id < 0 || id > 255)
+        {
+            throw std::runtime_error("bad line in session key file " + path + ": " + line);
+        }
+        keys.push_back(Key{static_cast<uint8_t>(id), secret});
+    }
+    return keys;
+}
+
+const CookieSessionStorage::DerivedKey* CookieSessionStorage::findKey(uint8_t id) const
+{
+    for (const DerivedKey& key : keys_)
+    {
+        if (key.id == id)
+        {
+            return &key;
+        }
+    }
+    return nullptr;
+}
+
+std::string CookieSessionStorage::cookieValue(const Session& session)
+{
+    const DerivedKey& key = keys_.front();
+    int64_t expiryMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+        session.expiryTime().time_since_epoch()).count();
+
+    std::string header;
+    header.push_back(static_cast<char>(kVersion));
+    header.push_back(static_cast<char>(key.id));
+    header.push_back(static_cast<char>(encrypt_ ? kEncrypted : 0));
+    putUint(header, static_cast<uint64_t>(expiryMs), 8);
+
+    std::string body;
+    if (session.getId().size() > 255)
+    {
+        throw std::length_error("session id too long for cookie");
+    }
+    putUint(body, session.getId().size(), 1);
+    body.append(session.getId());
+    session.forEachValue([&body](const std::string& key, const std::string& value)
+    {
+        if (key.size() > 0xffff || value.size() > 0xffff)
+        {
+            throw std::length_error("session value too long for cookie: " + key);
+        }
+        putUint(body, key.size(), 2);
+        body.append(key);
+        putUint(body, value.size(), 2);
+        body.append(value);
+    });
+
+    std::string token = encodeBase64Url(seal(key, header, body));
+    if (token.size() > kMaxCookieBytes)
+    {
+        throw std::length_error("session too large for cookie: " + std::to_string(token.size()) + " bytes");
+    }
+    return token;
+}
+
+std::string CookieSessionStorage::seal(const DerivedKey& key, const std::string& header, const std::string& body) const
+{
+    std::string out = header;
+    if (!encrypt_)
+    {
+        out.append(body);
+        unsigned char mac[kMacBytes];
+        hmacSha256(key.macKey, sizeof(key.macKey), out.data(), out.size(), mac);
+        out.append(reinterpret_cast<const char*>(mac), kMacBytes);
+        return out;
+    }
+
+    unsigned char iv[kIvBytes];
+    if (RAND_bytes(iv, kIvBytes) != 1)
+    {
+        throw std::runtime_error("RAND_bytes failed");
+    }
+    out.append(reinterpret_cast<const char*>(iv), kIvBytes);
+    size_t cipherPos = out.size();
+    out.resize(cipherPos + body.size() + kTagBytes);
+    unsigned char* cipher = reinterpret_cast<unsigned char*>(&out[cipherPos]);
+
+    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+    int len = 0;
+    int finalLen = 0;
+    bool ok = ctx
+        && EVP_EncryptInit_ex(ctx, EVP_aes_256_gcm(), nullptr, key.encKey, iv) == 1
+        && EVP_EncryptUpdate(ctx, nullptr, &len, reinterpret_cast<const unsigned char*>(header.data()),
+                             static_cast<int>(header.size())) == 1
+        && EVP_EncryptUpdate(ctx, cipher, &len, reinterpret_cast<const unsigned char*>(body.data()),
+                             static_cast<int>(body.size())) == 1
+        && EVP_EncryptFinal_ex(ctx, cipher + len, &finalLen) == 1
+        && EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, kTagBytes, cipher + body.size()) == 1;
+    EVP_CIPHER_CTX_free(ctx);
+    if (!ok)
+    {
+        throw std::runtime_error("session cookie encryption failed");
+    }
+    return out;
+}
+
+bool CookieSessionStorage::open(const DerivedKey& key, const std::string& token, std::string* body) const
+{
+    const unsigned char* data = reinterpret_cast<const unsigned char*>(token.data());
+    if (!(data[2] & kEncrypted))
+    {
+        if (token.size() < kHeaderBytes + kMacBytes)
+        {
+            return false;
+        }
+        size_t signedSize = token.size() - kMacBytes;
+        unsigned char mac[kMacBytes];
+        hmacSha256(key.macKey, sizeof(key.macKey), data, signedSize, mac);
+        // 常数时间比较，避免通过响应时间逐字节猜出签名
+        if (CRYPTO_memcmp(mac, data + signedSize, kMacBytes) != 0)
+        {
+            return false;
+        }
+        body->assign(token, kHeaderBytes, signedSize - kHeaderBytes);
+        return true;
+    }
+
+    if (token.size() < kHeaderBytes + kIvBytes + kTagBytes)
+    {
+        return false;
+    }
+    const unsigned char* iv = data + kHeaderBytes;
+    const unsigned char* cipher = iv + kIvBytes;
+    size_t cipherSize = token.size() - kHeaderBytes - kIvBytes - kTagBytes;
+    unsigned char tag[kTagBytes];
+    std::copy(cipher + cipherSize, cipher + cipherSize + kTagBytes, tag);
+    body->resize(cipherSize);
+
+    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+    int len = 0;
+    int finalLen = 0;
+    unsigned char* plain = reinterpret_cast<unsigned char*>(&(*body)[0]);
+    bool ok = ctx
+        && EVP_DecryptInit_ex(ctx, EVP_aes_256_gcm(), nullptr, key.encKey, iv) == 1
+        && EVP_DecryptUpdate(ctx, nullptr, &len, data, kHeaderBytes) == 1
+        && EVP_DecryptUpdate(ctx, plain, &len, cipher, static_cast<int>(cipherSize)) == 1
+        && EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, kTagBytes, tag) == 1
+        && EVP_DecryptFinal_ex(ctx, plain + len, &finalLen) == 1; // tag不对时失败
+    EVP_CIPHER_CTX_free(ctx);
+    return ok;
+}
+
+std::shared_ptr<Session> CookieSessionStorage::load(const std::string& sessionId)
+{
+    std::string token;
+    if (!decodeBase64Url(sessionId, &token) || token.size() < kHeaderBytes
+        || static_cast<uint8_t>(token[0]) != kVersion)
+    {
+        return nullptr;
+    }
+    // 密钥已经被轮换掉的cookie直接作废
+    const DerivedKey* key = findKey(static_cast<uint8_t>(token[1]));
+    if (!key)
+    {
+        return nullptr;
+    }
+    // 配置为加密时不接受只签名的cookie，反过来可以接受，方便从只签名平滑切换到加密
+    bool encrypted = static_cast<uint8_t>(token[2]) & kEncrypted;
+    if (encrypt_ && !encrypted)
+    {
+        return nullptr;
+    }
+
+    Reader header(token.data() + 3, kHeaderBytes - 3);
+    int64_t expiryMs = static_cast<int64_t>(header.uint(8));
+    if (expiryMs <= nowMs())
+    {
+        return nullptr;
+    }
+
+    std::string body;
+    if (!open(*key, token, &body))
+    {
+        return nullptr;
+    }
+
+    Reader reader(body.data(), body.size());
+    std::string id = reader.bytes(reader.uint(1));
+    auto session = std::make_shared<Session>(id, nullptr);
+    while (reader.ok() && !reader.done())
+    {
+        std::string k = reader.bytes(reader.uint(2));
+        std::string v = reader.bytes(reader.uint(2));
+        if (reader.ok())
+        {
+            session->setValue(k, v);
+        }
+    }
+    if (!reader.ok())
+    {
+        return nullptr;
+    }
+    session->setExpiryTime(std::chrono::system_clock::time_point(std::chrono::milliseconds(expiryMs)));
+    session->clearDirty(); // 和cookie中的一致
+    return session;
+}
+}
+}
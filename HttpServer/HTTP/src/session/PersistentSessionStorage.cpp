@@ -0,0 +1,624 @@
+#include "../../include/session/PersistentSessionStorage.h"
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+#include <muduo/base/Logging.h>
+
+namespace http
+{
+namespace session
+{
+namespace
+{
+const uint8_t kPut = 1;
+const uint8_t kRemove = 2;
+const size_t kHeaderBytes = 8; // uint32 长度 + uint32 crc32
+
+int64_t nowMs()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+uint64_t roundUp(uint64_t size, uint64_t unit)
+{
+    return (size + unit - 1) / unit * unit;
+}
+
+template <typename T>
+void appendPod(std::string& out, T value)
+{
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+std::string encode(uint8_t type, const std::string& id, int64_t expiryMs, const Session* session)
+{
+    std::string record(kHeaderBytes, '\0');
+    appendPod<uint8_t>(record, type);
+    appendPod<int64_t>(record, expiryMs);
+    appendPod<uint16_t>(record, static_cast<uint16_t>(id.size()));
+    record += id;
+    // 条目数在遍历时统计，和写入的条目出自同一次加锁，其他线程同时修改会话也不会不一致
+    size_t countOffset = record.size();
+    uint32_t count = 0;
+    appendPod<uint32_t>(record, count);
+    if (session)
+    {
+        session->forEachValue([&record, &count](const std::string& key, const std::string& value)
+        {
+            appendPod<uint32_t>(record, static_cast<uint32_t>(key.size()));
+            record += key;
+            appendPod<uint32_t>(record, static_cast<uint32_t>(value.size()));
+            record += value;
+            ++count;
+        });
+    }
+    std::memcpy(&record[countOffset], &count, sizeof(count));
+    uint32_t length = static_cast<uint32_t>(record.size() - kHeaderBytes);
+    uint32_t crc = static_cast<uint32_t>(::crc32(0, reinterpret_cast<const Bytef*>(record.data() + kHeaderBytes), length));
+    std::memcpy(&record[0], &length, sizeof(length));
+    std::memcpy(&record[4], &crc, sizeof(crc));
+    return record;
+}
+
+// 按顺序读取记录的字段，越界时ok变为false
+class Reader
+{
+public:
+    Reader(const char* data, size_t size) : p_(data), end_(data + size), ok_(true) {}
+
+    template <typename T>
+    T pod()
+    {
+        T value {};
+        if (static_cast<size_t>(end_ - p_) < sizeof(T))
+        {
+            ok_ = false;
+            return value;
+        }
+        std::memcpy(&value, p_, sizeof(T));
+        p_ += sizeof(T);
+        return value;
+    }
+
+    std::string_view bytes(size_t n)
+    {
+        if (static_cast<size_t>(end_ - p_) < n)
+        {
+            ok_ = false;
+            return std::string_view();
+        }
+        std::string_view s(p_, n);
+        p_ += n;
+        return s;
+    }
+
+    bool ok() const { return ok_; }
+
+private:
+    const char* p_;
+    const char* end_;
+    bool ok_;
+};
+
+struct Record
+{
+    uint8_t type;
+    int64_t expiryMs;
+    std::string_view id;
+    uint32_t count;
+    const char* pairs; // 键值对的起点
+    size_t pairsSize;
+};
+
+// 校验并解析一条记录，data指向记录头；返回记录的总长度，记录无效时返回0
+size_t decode(const char* data, uint64_t available, Record* record)
+{
+    if (available < kHeaderBytes)
+    {
+        return 0;
+    }
+    uint32_t length;
+    uint32_t crc;
+    std::memcpy(&length, data, sizeof(length));
+    std::memcpy(&crc, data + 4, sizeof(crc));
+    if (length == 0 || length > available - kHeaderBytes)
+    {
+        return 0;
+    }
+    const char* payload = data + kHeaderBytes;
+    if (static_cast<uint32_t>(::crc32(0, reinterpret_cast<const Bytef*>(payload), length)) != crc)
+    {
+        return 0;
+    }
+
+    Reader reader(payload, length);
+    record->type = reader.pod<uint8_t>();
+    record->expiryMs = reader.pod<int64_t>();
+    record->id = reader.bytes(reader.pod<uint16_t>());
+    record->count = reader.pod<uint32_t>();
+    if (!reader.ok() || (record->type != kPut && record->type != kRemove))
+    {
+        return 0;
+    }
+    record->pairs = record->id.data() + record->id.size() + sizeof(uint32_t);
+    record->pairsSize = payload + length - record->pairs;
+    return kHeaderBytes + length;
+}
+
+bool writeAll(int fd, const char* data, size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t n = ::write(fd, data, size);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return false;
+        }
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// rename之后同步目录，保证替换本身也落盘
+void syncDir(const std::string& path)
+{
+    size_t slash = path.rfind('/');
+    std::string dir = slash == std::string::npos ? "." : (slash == 0 ? "/" : path.substr(0, slash));
+    int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd >= 0)
+    {
+        ::fsync(fd);
+        ::close(fd);
+    }
+}
+} // namespace
+
+PersistentSessionStorage::PersistentSessionStorage(const std::string& path, size_t maxCachedSessions)
+    : path_(path),
+      lockFd_(-1),
+      cache_(maxCachedSessions),
+      fd_(-1),
+      map_(nullptr),
+      capacity_(0),
+      tail_(0),
+      liveBytes_(0),
+      running_(true)
+{
+    open();
+    scan();
+    syncThread_ = std::thread(&PersistentSessionStorage::syncThreadFunc, this);
+}
+
+PersistentSessionStorage::~PersistentSessionStorage()
+{
+    {
+        std::lock_guard<std::mutex> lock(stopMutex_);
+        running_.store(false);
+    }
+    stopCond_.notify_all();
+    if (syncThread_.joinable())
+    {
+        syncThread_.join();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    ::fdatasync(fd_);
+    unmapFile();
+    // 去掉末尾预留的空间，下次启动时文件大小就是日志大小
+    if (::ftruncate(fd_, static_cast<off_t>(tail_)) != 0)
+    {
+        LOG_SYSERR << "ftruncate session log " << path_;
+    }
+    ::close(fd_);
+    ::close(lockFd_); // 最后释放锁，之后其他进程才能打开
+}
+
+void PersistentSessionStorage::open()
+{
+    std::string lockPath = path_ + ".lock";
+    lockFd_ = ::open(lockPath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (lockFd_ < 0)
+    {
+        throw std::runtime_error("cannot open " + lockPath + ": " + std::strerror(errno));
+    }
+    if (::flock(lockFd_, LOCK_EX | LOCK_NB) != 0)
+    {
+        int err = errno;
+        ::close(lockFd_);
+        if (err == EWOULDBLOCK)
+        {
+            throw std::runtime_error("session log " + path_ + " is in use by another process");
+        }
+        throw std::runtime_error("cannot lock " + lockPath + ": " + std::strerror(err));
+    }
+
+    fd_ = ::open(path_.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd_ < 0)
+    {
+        int err = errno;
+        ::close(lockFd_);
+        throw std::runtime_error("cannot open session log " + path_ + ": " + std::strerror(err));
+    }
+    struct stat st;
+    if (::fstat(fd_, &st) != 0)
+    {
+        int err = errno;
+        ::close(fd_);
+        ::close(lockFd_);
+        throw std::runtime_error("cannot stat session log " + path_ + ": " + std::strerror(err));
+    }
+    if (!mapFile(roundUp(std::max<uint64_t>(st.st_size, 1), kGrowBytes)))
+    {
+        int err = errno;
+        ::close(fd_);
+        ::close(lockFd_);
+        throw std::runtime_error("cannot map session log " + path_ + ": " + std::strerror(err));
+    }
+}
+
+void PersistentSessionStorage::scan()
+{
+    uint64_t offset = 0;
+    size_t records = 0;
+    Record record;
+    while (size_t total = decode(map_ + offset, capacity_ - offset, &record))
+    {
+        if (record.type == kPut)
+        {
+            index_[std::string(record.id)] = IndexEntry{offset, static_cast<uint32_t>(total), record.expiryMs};
+        }
+        else
+        {
+            index_.erase(std::string(record.id));
+        }
+        offset += total;
+        ++records;
+    }
+    tail_ = offset;
+
+    // 末尾不全是0说明上次写了一半，清掉，免得和之后追加的记录连在一起
+    for (uint64_t i = tail_; i < capacity_; ++i)
+    {
+        if (map_[i] != 0)
+        {
+            LOG_WARN << "Session log " << path_ << " truncated at " << tail_;
+            std::memset(map_ + tail_, 0, capacity_ - tail_);
+            break;
+        }
+    }
+
+    int64_t now = nowMs();
+    for (auto it = index_.begin(); it != index_.end();)
+    {
+        if (it->second.expiryMs <= now)
+        {
+            it = index_.erase(it);
+        }
+        else
+        {
+            liveBytes_ += it->second.length;
+            ++it;
+        }
+    }
+    LOG_INFO << "Session log " << path_ << " loaded: " << records << " records, "
+             << index_.size() << " live sessions, " << tail_ << " bytes";
+}
+
+bool PersistentSessionStorage::mapFile(uint64_t capacity)
+{
+    if (::ftruncate(fd_, static_cast<off_t>(capacity)) != 0)
+    {
+        return false;
+    }
+    void* map = ::mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (map == MAP_FAILED)
+    {
+        return false;
+    }
+    map_ = static_cast<char*>(map);
+    capacity_ = capacity;
+    return true;
+}
+
+void PersistentSessionStorage::unmapFile()
+{
+    if (map_)
+    {
+        ::munmap(map_, capacity_);
+        map_ = nullptr;
+        capacity_ = 0;
+    }
+}
+
+uint64_t PersistentSessionStorage::append(const std::string& record)
+{
+    if (tail_ + record.size() > capacity_)
+    {
+        uint64_t capacity = roundUp(std::max(tail_ + record.size(), capacity_ + kGrowBytes), kGrowBytes);
+        if (::ftruncate(fd_, static_cast<off_t>(capacity)) != 0)
+        {
+            throw std::runtime_error(std::string("cannot grow session log: ") + std::strerror(errno));
+        }
+        void* map = ::mremap(map_, capacity_, capacity, MREMAP_MAYMOVE);
+        if (map == MAP_FAILED)
+        {
+            throw std::runtime_error(std::string("cannot remap session log: ") + std::strerror(errno));
+        }
+        map_ = static_cast<char*>(map);
+        capacity_ = capacity;
+    }
+    uint64_t offset = tail_;
+    std::memcpy(map_ + offset, record.data(), record.size());
+    tail_ += record.size();
+    return offset;
+}
+
+void PersistentSessionStorage::save(std::shared_ptr<Session> session)
+{
+    int64_t expiryMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+        session->expiryTime().time_since_epoch()).count();
+    // 在锁外编码，锁内只有一次内存拷贝
+    std::string record = encode(kPut, session->getId(), expiryMs, session.get());
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        uint64_t offset = append(record);
+        index_[session->getId()] = IndexEntry{offset, static_cast<uint32_t>(record.size()), expiryMs};
+    }
+    cache_.save(std::move(session));
+}
+
+std::shared_ptr<Session> PersistentSessionStorage::load(const std::string& sessionId)
+{
+    // 伪造的id和旧版本生成的id都不查日志，旧会话到期后由压缩清理
+    SessionKey key;
+    if (!SessionKey::parse(sessionId, &key))
+    {
+        return nullptr;
+    }
+    std::shared_ptr<Session> session = cache_.load(sessionId);
+    if (session)
+    {
+        return session;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = index_.find(sessionId);
+        if (it == index_.end())
+        {
+            return nullptr;
+        }
+        if (it->second.expiryMs <= nowMs())
+        {
+            index_.erase(it); // 过期的记录在下次压缩时丢弃
+            return nullptr;
+        }
+        session = restore(it->second);
+    }
+    cache_.save(session);
+    return session;
+}
+
+std::shared_ptr<Session> PersistentSessionStorage::restore(const IndexEntry& entry) const
+{
+    Record record;
+    decode(map_ + entry.offset, entry.length, &record);
+    auto session = std::make_shared<Session>(std::string(record.id), nullptr);
+    Reader reader(record.pairs, record.pairsSize);
+    for (uint32_t i = 0; i < record.count && reader.ok(); ++i)
+    {
+        std::string_view key = reader.bytes(reader.pod<uint32_t>());
+        std::string_view value = reader.bytes(reader.pod<uint32_t>());
+        if (reader.ok())
+        {
+            session->setValue(std::string(key), std::string(value));
+        }
+    }
+    session->setExpiryTime(std::chrono::system_clock::time_point(std::chrono::milliseconds(entry.expiryMs)));
+    session->clearDirty(); // 和日志中的一致
+    return session;
+}
+
+void PersistentSessionStorage::remove(const std::string& sessionId)
+{
+    cache_.remove(sessionId);
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(sessionId);
+    if (it == index_.end())
+    {
+        return;
+    }
+    index_.erase(it);
+    append(encode(kRemove, sessionId, 0, nullptr));
+}
+
+void PersistentSessionStorage::cleanExpired()
+{
+    // 日志中过期的会话在压缩时丢弃
+    cache_.cleanExpired();
+}
+
+size_t PersistentSessionStorage::size() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return index_.size();
+}
+
+uint64_t PersistentSessionStorage::logBytes() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return tail_;
+}
+
+void PersistentSessionStorage::syncThreadFunc()
+{
+    const int kCompactCheckTicks = 1000 / kSyncIntervalMs; // 大约每秒检查一次是否需要压缩
+    uint64_t synced = 0;
+    int ticks = 0;
+    while (running_.load())
+    {
+        {
+            std::unique_lock<std::mutex> lock(stopMutex_);
+            stopCond_.wait_for(lock, std::chrono::milliseconds(kSyncIntervalMs), [this]() { return !running_.load(); });
+        }
+
+        // 这段时间内所有的写入一起落盘
+        uint64_t tail;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            tail = tail_;
+        }
+        if (tail != synced)
+        {
+            if (::fdatasync(fd_) != 0) // fd_只在这个线程中替换
+            {
+                LOG_SYSERR << "fdatasync session log " << path_;
+            }
+            synced = tail;
+        }
+
+        if (++ticks >= kCompactCheckTicks)
+        {
+            ticks = 0;
+            bool need;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                need = needCompact();
+            }
+            if (need)
+            {
+                compact();
+                synced = UINT64_MAX; // 替换后追加的记录在下一轮落盘
+            }
+        }
+    }
+}
+
+bool PersistentSessionStorage::needCompact() const
+{
+    return tail_ > kMinCompactBytes && tail_ > 2 * liveBytes_;
+}
+
+// 1. 持锁复制有效的记录，记下当时的日志末尾
+// 2. 不持锁写入新文件并落盘
+// 3. 压缩期间追加的记录：持锁只做内存复制，不持锁写入新文件并落盘，直到剩下的不多
+// 4. 持锁把最后剩下的记录接到新文件后面，替换旧文件，修正索引中的偏移；
+//    最后这一小段和平时的写入一样由下一轮组提交落盘
+void PersistentSessionStorage::compact()
+{
+    const uint64_t kMaxLockedWriteBytes = 64 * 1024; // 持锁写入的最大字节数
+    const int kMaxCatchUpRounds = 4;
+
+    std::string snapshot;
+    std::unordered_map<std::string, uint64_t> moved; // id -> 在新文件中的偏移
+    uint64_t startOffset;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        startOffset = tail_;
+        snapshot.reserve(liveBytes_);
+        int64_t now = nowMs();
+        for (auto it = index_.begin(); it != index_.end();)
+        {
+            if (it->second.expiryMs <= now)
+            {
+                it = index_.erase(it);
+                continue;
+            }
+            moved.emplace(it->first, snapshot.size());
+            snapshot.append(map_ + it->second.offset, it->second.length);
+            ++it;
+        }
+    }
+
+    const std::string tmpPath = path_ + ".compact";
+    int fd = ::open(tmpPath.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    bool ok = fd >= 0 && writeAll(fd, snapshot.data(), snapshot.size()) && ::fdatasync(fd) == 0;
+
+    // 旧日志中[startOffset, copied)的记录已经写入新文件
+    uint64_t copied = startOffset;
+    std::string delta;
+    for (int round = 0; ok && round < kMaxCatchUpRounds; ++round)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (tail_ - copied <= kMaxLockedWriteBytes)
+            {
+                break;
+            }
+            delta.assign(map_ + copied, tail_ - copied); // 映射可能被append移动，只能持锁读取
+            copied = tail_;
+        }
+        ok = writeAll(fd, delta.data(), delta.size()) && ::fdatasync(fd) == 0;
+    }
+    if (!ok)
+    {
+        LOG_SYSERR << "Session log compaction failed: " << tmpPath;
+        if (fd >= 0)
+        {
+            ::close(fd);
+        }
+        ::unlink(tmpPath.c_str());
+        return;
+    }
+
+    int oldFd;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!writeAll(fd, map_ + copied, tail_ - copied) || ::rename(tmpPath.c_str(), path_.c_str()) != 0)
+        {
+            LOG_SYSERR << "Session log compaction failed: " << tmpPath;
+            ::close(fd);
+            ::unlink(tmpPath.c_str());
+            return;
+        }
+
+        uint64_t tailBytes = tail_ - startOffset;
+        uint64_t before = tail_;
+        unmapFile();
+        oldFd = fd_;
+        fd_ = fd;
+        uint64_t size = snapshot.size() + tailBytes;
+        if (!mapFile(roundUp(size + 1, kGrowBytes)))
+        {
+            LOG_SYSFATAL << "cannot map compacted session log " << path_;
+        }
+        tail_ = size;
+        liveBytes_ = size;
+        for (auto& kv : index_)
+        {
+            IndexEntry& entry = kv.second;
+            if (entry.offset >= startOffset)
+            {
+                entry.offset = entry.offset - startOffset + snapshot.size(); // 压缩期间追加的
+            }
+            else
+            {
+                entry.offset = moved[kv.first];
+            }
+        }
+        LOG_INFO << "Session log " << path_ << " compacted: " << before << " -> " << size << " bytes, "
+                 << index_.size() << " live sessions";
+    }
+    ::close(oldFd);
+    syncDir(path_);
+}
+
+} // namespace session
+} // namespace http
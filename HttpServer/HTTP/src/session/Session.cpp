@@ -1,54 +1,261 @@
 #include "../../include/session/Session.h"
 #include "../../include/session/SessionManager.h"
+#include <charconv>
 
 namespace http
 {
 namespace session
 {
+const std::string Session::kUserIdKey = "userId";
+const std::string Session::kUsernameKey = "username";
+const std::string Session::kLoggedInKey = "isLoggedIn";
+
 Session::Session(const std::string& sessionId, SessionManager* SessionManager, int maxAge)
                 : sessionId_(sessionId), maxAge_(maxAge), sessionManager_(SessionManager)
+                , flags_(0), userId_(0)
 {
     refresh(); // 初始化设置过期时间
 }
 
 bool Session::isExpired() const
 {
+    std::lock_guard<std::mutex> lock(mutex_);
     return std::chrono::system_clock::now() > expiryTime_;
 }
 
 void Session::refresh()
 {
+    std::lock_guard<std::mutex> lock(mutex_);
     expiryTime_ = std::chrono::system_clock::now() + std::chrono::seconds(maxAge_);
+    // 持久化的存储中过期时间不用每个请求都更新，落后太多时再写一次
+    if (expiryTime_ - savedExpiryTime_ > std::chrono::seconds(maxAge_) / 10)
+    {
+        flags_ |= kDirty;
+    }
+}
+
+std::chrono::system_clock::time_point Session::expiryTime() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return expiryTime_;
+}
+
+void Session::setExpiryTime(std::chrono::system_clock::time_point expiryTime)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    expiryTime_ = expiryTime;
+}
+
+void Session::setManager(SessionManager* SessionManager)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    sessionManager_ = SessionManager;
+}
+
+SessionManager* Session::getManager() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return sessionManager_;
+}
+
+bool Session::isDirty() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return (flags_ & (kDirty | kDestroyed)) == kDirty;
+}
+
+void Session::markDirty()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    flags_ |= kDirty;
+}
+
+void Session::clearDirty()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    flags_ &= ~kDirty;
+    savedExpiryTime_ = expiryTime_;
+}
+
+void Session::markDestroyed()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    flags_ |= kDestroyed;
+}
+
+bool Session::isDestroyed() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return flags_ & kDestroyed;
+}
+
+bool Session::hasUserId() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return flags_ & kHasUserId;
+}
+
+int64_t Session::userId() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return userId_;
+}
+
+void Session::setUserId(int64_t userId)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    setUserIdLocked(userId);
+}
+
+std::string Session::username() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return username_;
+}
+
+void Session::setUsername(const std::string& username)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    setUsernameLocked(username);
+}
+
+bool Session::isLoggedIn() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return flags_ & kLoggedIn;
+}
+
+void Session::setLoggedIn(bool loggedIn)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    setLoggedInLocked(loggedIn);
+}
+
+void Session::setUserIdLocked(int64_t userId)
+{
+    if (!(flags_ & kHasUserId) || userId_ != userId)
+    {
+        userId_ = userId;
+        flags_ |= kHasUserId | kDirty;
+    }
+}
+
+void Session::setUsernameLocked(const std::string& username)
+{
+    if (username_ != username)
+    {
+        username_ = username;
+        flags_ |= kDirty;
+    }
+}
+
+void Session::setLoggedInLocked(bool loggedIn)
+{
+    if (static_cast<bool>(flags_ & kLoggedIn) != loggedIn)
+    {
+        flags_ = loggedIn ? (flags_ | kLoggedIn) : (flags_ & ~kLoggedIn);
+        flags_ |= kDirty;
+    }
 }
 
 void Session::setValue(const std::string& key, const std::string& value)
 {
-    data_[key] = value;
-    if (sessionManager_)
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (key == kUserIdKey)
+    {
+        int64_t userId = 0;
+        auto result = std::from_chars(value.data(), value.data() + value.size(), userId);
+        if (result.ec == std::errc() && result.ptr == value.data() + value.size())
+        {
+            setUserIdLocked(userId);
+        }
+        else
+        {
+            removeLocked(key);
+        }
+        return;
+    }
+    if (key == kUsernameKey)
     {
-        // update memory
-        sessionManager_->updateSessionId(shared_from_this());
+        setUsernameLocked(value);
+        return;
     }
+    if (key == kLoggedInKey)
+    {
+        setLoggedInLocked(value == "true");
+        return;
+    }
+    if (!extra_)
+    {
+        extra_ = std::make_unique<std::unordered_map<std::string, std::string>>();
+    }
+    (*extra_)[key] = value;
+    flags_ |= kDirty;
 }
 
 std::string Session::getValue(const std::string& key) const
 {
-    auto it = data_.find(key);
-    return it != data_.end() ? it->second : std::string(); // 没有kv就是返回空字符
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (key == kUserIdKey)
+    {
+        return (flags_ & kHasUserId) ? std::to_string(userId_) : std::string();
+    }
+    if (key == kUsernameKey)
+    {
+        return username_;
+    }
+    if (key == kLoggedInKey)
+    {
+        return (flags_ & kLoggedIn) ? "true" : std::string();
+    }
+    if (!extra_)
+    {
+        return std::string();
+    }
+    auto it = extra_->find(key);
+    return it != extra_->end() ? it->second : std::string(); // 没有kv就是返回空字符
 }
 
 void Session::remove(const std::string& key)
 {
-    auto it = data_.find(key);
-    if (it != data_.end())
+    std::lock_guard<std::mutex> lock(mutex_);
+    removeLocked(key);
+}
+
+void Session::removeLocked(const std::string& key)
+{
+    if (key == kUserIdKey)
+    {
+        if (flags_ & kHasUserId)
+        {
+            userId_ = 0;
+            flags_ = (flags_ & ~kHasUserId) | kDirty;
+        }
+        return;
+    }
+    if (key == kUsernameKey)
     {
-        data_.erase(it);
+        setUsernameLocked(std::string());
+        return;
+    }
+    if (key == kLoggedInKey)
+    {
+        setLoggedInLocked(false);
+        return;
+    }
+    if (extra_ && extra_->erase(key) > 0)
+    {
+        flags_ |= kDirty;
     }
 }
 
 void Session::clear()
 {
-    data_.clear();
+    std::lock_guard<std::mutex> lock(mutex_);
+    userId_ = 0;
+    username_.clear();
+    extra_.reset();
+    flags_ = (flags_ & ~(kHasUserId | kLoggedIn)) | kDirty;
+}
 }
 }
-}
\ No newline at end of file
@@ -0,0 +1,89 @@
+#include "../../include/session/SessionKey.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <openssl/rand.h>
+
+namespace http
+{
+namespace session
+{
+namespace
+{
+const char kHexDigits[] = "0123456789abcdef";
+
+// 每个线程一次取够256个id的随机数，RAND_bytes内部的加锁和系统调用分摊到很多次生成上
+struct RandomBuffer
+{
+    unsigned char bytes[4096];
+    size_t pos = sizeof(bytes);
+};
+thread_local RandomBuffer tRandom;
+
+int hexValue(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+bool parseHalf(const char* p, uint64_t* out)
+{
+    uint64_t v = 0;
+    for (int i = 0; i < 16; ++i)
+    {
+        int d = hexValue(p[i]);
+        if (d < 0)
+        {
+            return false;
+        }
+        v = (v << 4) | static_cast<uint64_t>(d);
+    }
+    *out = v;
+    return true;
+}
+
+void formatHalf(uint64_t v, char* p)
+{
+    for (int i = 15; i >= 0; --i)
+    {
+        p[i] = kHexDigits[v & 0xf];
+        v >>= 4;
+    }
+}
+} // namespace
+
+SessionKey SessionKey::generate()
+{
+    RandomBuffer& buf = tRandom;
+    if (buf.pos + 16 > sizeof(buf.bytes))
+    {
+        if (RAND_bytes(buf.bytes, sizeof(buf.bytes)) != 1)
+        {
+            throw std::runtime_error("RAND_bytes failed");
+        }
+        buf.pos = 0;
+    }
+    SessionKey key;
+    std::memcpy(&key.hi, buf.bytes + buf.pos, 8);
+    std::memcpy(&key.lo, buf.bytes + buf.pos + 8, 8);
+    std::memset(buf.bytes + buf.pos, 0, 16); // 用过的随机数不留在内存里
+    buf.pos += 16;
+    return key;
+}
+
+bool SessionKey::parse(const std::string& id, SessionKey* key)
+{
+    return id.size() == kHexLength && parseHalf(id.data(), &key->hi) && parseHalf(id.data() + 16, &key->lo);
+}
+
+std::string SessionKey::toString() const
+{
+    std::string id(kHexLength, '0');
+    formatHalf(hi, &id[0]);
+    formatHalf(lo, &id[16]);
+    return id;
+}
+}
+}
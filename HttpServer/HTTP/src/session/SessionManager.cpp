@@ -1,7 +1,6 @@
 #include "../../include/session/SessionManager.h"
-#include <iomanip>
-#include <iostream>
-#include <sstream>
+#include "../../include/session/SessionKey.h"
+#include "../../include/trace/Tracer.h"
 
 namespace http
 {
@@ -9,7 +8,6 @@ namespace session
 {
 SessionManager::SessionManager(std::unique_ptr<SessionStorage> storage) 
                         : storage_(std::move(storage))
-                        , rng_(std::random_device{}())
 {}
 
 std::shared_ptr<Session> SessionManager::getSession(const HttpRequest& req, HttpResponse* resp)
@@ -18,41 +16,76 @@ std::shared_ptr<Session> SessionManager::getSession(const HttpRequest& req, Http
     // 没有发生过自然是新创建一个会话
 
     // 从request_的请求头中的cookie字段获得sessionId
-    std::string sessionId = getSessionIdFromCookie(req);
-    std::shared_ptr<Session> session;
-
-    // 从内存中找到属于的会话
-    if (!sessionId.empty())
+    trace::Span span("session", "getSession");
+    std::shared_ptr<Session> session = findSession(req);
+    if (session)
     {
-        session = storage_->load(sessionId);
+        return session;
     }
+
     // 创建一个新会话
-    if (!session || session->isExpired())
+    std::string sessionId = generateSessionId();
+    session = std::make_shared<Session>(sessionId, this); // 创建一个session对象
+    session->markDirty(); // 新会话在请求结束时写入存储
+    if (!storage_->storesInCookie())
     {
-        sessionId = generateSessionId();// 
-        session = std::make_shared<Session>(sessionId, this); // 创建一个session对象
         setSessionCookie(sessionId, resp);// 将标识符构建到响应中准备发送给客户端
     }
-    else // 否则为现有会话设置管理器
+    session->refresh();// 创建了一个新的会话计算过期时间
+    req.setSession(session);
+    return session;
+}
+
+std::shared_ptr<Session> SessionManager::findSession(const HttpRequest& req)
+{
+    if (req.session())
+    {
+        return req.session();
+    }
+    std::string sessionId = getSessionIdFromCookie(req);
+    if (sessionId.empty())
+    {
+        return nullptr;
+    }
+    // 从存储中找到属于的会话
+    std::shared_ptr<Session> session = storage_->load(sessionId);
+    if (!session || session->isExpired())
     {
-        session->setManager(this);
+        return nullptr;
     }
-    session->refresh();// 又开始使用该会话，过期时间延迟/创建了一个新的会话计算过期时间
-    storage_->save(session); // 保存到内存中
+    session->setManager(this); // 为现有会话设置管理器
+    session->refresh();// 又开始使用该会话，过期时间延迟
+    req.setSession(session);
     return session;
 }
 
-std::string SessionManager::generateSessionId()
+void SessionManager::commit(const HttpRequest& req, HttpResponse* resp)
 {
-    std::stringstream ss;
-    std::uniform_int_distribution<> dist(0, 15);
-
-    // 生成32个字符的会话id，每个字符是一个十六进制数字
-    for (int i = 1; i  < 32; ++i)
+    const std::shared_ptr<Session>& session = req.session();
+    if (!session)
+    {
+        return;
+    }
+    if (storage_->storesInCookie() && session->isDestroyed())
     {
-        ss << std::hex << dist(rng_);
+        clearSessionCookie(resp);
+        return;
+    }
+    if (session->isDirty())
+    {
+        session->clearDirty();
+        storage_->save(session);
+        if (storage_->storesInCookie())
+        {
+            setSessionCookie(storage_->cookieValue(*session), resp);
+        }
     }
-    return ss.str();
+}
+
+std::string SessionManager::generateSessionId()
+{
+    // 128位随机数，32个十六进制字符，id不可预测才不会被别人猜到冒用
+    return SessionKey::generate().toString();
 }
 
 void SessionManager::destroySession(const std::string& sessionId)
@@ -60,11 +93,22 @@ void SessionManager::destroySession(const std::string& sessionId)
     storage_->remove(sessionId);
 }
 
+void SessionManager::destroySession(const std::shared_ptr<Session>& session)
+{
+    session->markDestroyed();
+    storage_->remove(session->getId());
+}
+
 void SessionManager::cleanExpiredSessions()
 {
-    // 对于内存存储的会话，可以在从内存中加载会话时检查是否过期
-    // 其他存储的实现视情况而定，可能需要定时清理会话
-    // 总的来说，这个实现依赖于存储的实现
+    // 加载会话时也会检查是否过期，这里清理的是不再有人访问的会话
+    // 具体的清理方式依赖于存储的实现
+    storage_->cleanExpired();
+}
+
+void SessionManager::startExpiry(muduo::net::EventLoop* loop, double interval)
+{
+    loop->runEvery(interval, [this]() { cleanExpiredSessions(); });
 }
 
 std::string SessionManager::getSessionIdFromCookie(const HttpRequest& req)
@@ -97,6 +141,11 @@ void SessionManager::setSessionCookie(const std::string& sessionId, HttpResponse
     resp->addHeader("Set-Cookie", cookie);
 }
 
+void SessionManager::clearSessionCookie(HttpResponse* resp)
+{
+    resp->addHeader("Set-Cookie", "sessionId=; Path=/; HttpOnly; Max-Age=0");
+}
+
 
 }
 }
@@ -1,39 +1,242 @@
 #include "../../include/session/SessionStorage.h"
+#include <algorithm>
 #include <iostream>
+#include <muduo/base/Logging.h>
 
 namespace http
 {
 namespace session
 {
+namespace
+{
+int64_t nowSeconds()
+{
+    return std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+} // namespace
+
 SessionStorage::~SessionStorage() = default;
 
+void SessionStorage::cleanExpired()
+{
+}
+
+bool SessionStorage::storesInCookie() const
+{
+    return false;
+}
+
+std::string SessionStorage::cookieValue(const Session& session)
+{
+    return session.getId();
+}
+
+MemorySessionStorage::MemorySessionStorage(size_t maxSessions)
+    : shardCapacity_(maxSessions == 0 ? 0 : (maxSessions + kShardCount - 1) / kShardCount)
+{
+    int64_t now = nowSeconds();
+    for (Shard& shard : shards_)
+    {
+        shard.wheel.resize(kWheelSize);
+        shard.cursor = now;
+    }
+}
+
 void MemorySessionStorage::save(std::shared_ptr<Session> session)
 {
-    sessions_[session->getId()] = session;
+    SessionKey key;
+    if (!SessionKey::parse(session->getId(), &key))
+    {
+        LOG_WARN << "Session id is not a 128-bit hex id, not stored: " << session->getId();
+        return;
+    }
+    Shard& shard = shardFor(key);
+    std::shared_ptr<Session> evicted; // 在锁外析构
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto result = shard.sessions.try_emplace(key);
+    Item& item = result.first->second;
+    item.session = std::move(session);
+    item.expiry = item.session->expiryTime(); // 保存会话的请求刚刚续期过
+    if (!result.second)
+    {
+        shard.lru.splice(shard.lru.begin(), shard.lru, item.lru);
+        return;
+    }
+
+    shard.lru.push_front(key);
+    item.lru = shard.lru.begin();
+    schedule(shard, key, item);
+    if (shardCapacity_ > 0 && shard.sessions.size() > shardCapacity_)
+    {
+        // 爬虫之类不带cookie的请求每次都会创建新会话，超过容量时淘汰最久没有使用的
+        evicted = erase(shard, shard.sessions.find(shard.lru.back()));
+        ++shard.evictions;
+    }
 }
 
 std::shared_ptr<Session> MemorySessionStorage::load(const std::string& sessionId) 
 {
-    auto it = sessions_.find(sessionId);
-    if (it != sessions_.end())
+    SessionKey key;
+    if (!SessionKey::parse(sessionId, &key))
     {
-        if (!it->second->isExpired())
-        {
-
-            return it->second;
-        }
-        else{
-            sessions_.erase(it); // 删除过期会话
-        }
+        return nullptr; // 伪造或者旧格式的id，不用加锁
     }
-    return nullptr;
+    Shard& shard = shardFor(key);
+    std::shared_ptr<Session> expired; // 在锁外析构
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.sessions.find(key);
+    if (it == shard.sessions.end())
+    {
+        return nullptr;
+    }
+    auto now = std::chrono::system_clock::now();
+    Item& item = it->second;
+    if (now > item.expiry)
+    {
+        expired = erase(shard, it); // 删除过期会话
+        return nullptr;
+    }
+    // 取出的会话接着会被续期（Session::refresh），这里同步延长存储中的过期时间
+    item.expiry = now + std::chrono::seconds(item.session->maxAge());
+    shard.lru.splice(shard.lru.begin(), shard.lru, item.lru);
+    return item.session;
 }
 
 void MemorySessionStorage::remove(const std::string& sessionId)
 {
-    auto it = sessions_.find(sessionId);
-    sessions_.erase(it);
+    SessionKey key;
+    if (!SessionKey::parse(sessionId, &key))
+    {
+        return;
+    }
+    Shard& shard = shardFor(key);
+    std::shared_ptr<Session> removed; // 在锁外析构
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.sessions.find(key);
+    if (it != shard.sessions.end()) // 不存在时什么也不做
+    {
+        removed = erase(shard, it);
+    }
 }
 
+void MemorySessionStorage::cleanExpired()
+{
+    auto now = std::chrono::system_clock::now();
+    std::vector<std::shared_ptr<Session>> released; // 在锁外析构
+    for (Shard& shard : shards_)
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        expireShard(shard, now, released);
+    }
+    if (!released.empty())
+    {
+        LOG_DEBUG << "Expired sessions removed: " << released.size();
+    }
+}
+
+size_t MemorySessionStorage::size() const
+{
+    size_t count = 0;
+    for (const Shard& shard : shards_)
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        count += shard.sessions.size();
+    }
+    return count;
+}
+
+size_t MemorySessionStorage::evictions() const
+{
+    size_t count = 0;
+    for (const Shard& shard : shards_)
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        count += shard.evictions;
+    }
+    return count;
+}
+
+// 过期时间所在的秒过去之后才一定过期，所以登记在下一秒
+int64_t MemorySessionStorage::expiryTick(std::chrono::system_clock::time_point expiry)
+{
+    return std::chrono::duration_cast<std::chrono::seconds>(expiry.time_since_epoch()).count() + 1;
+}
+
+void MemorySessionStorage::schedule(Shard& shard, const SessionKey& key, Item& item)
+{
+    item.wheelTick = std::max(expiryTick(item.expiry), shard.cursor);
+    shard.wheel[item.wheelTick & (kWheelSize - 1)].push_back(key);
+}
+
+std::shared_ptr<Session> MemorySessionStorage::erase(Shard& shard, SessionMap::iterator it)
+{
+    // 时间轮中的记录不用删除，检查时发现会话不在了就丢弃
+    std::shared_ptr<Session> session = std::move(it->second.session);
+    shard.lru.erase(it->second.lru);
+    shard.sessions.erase(it);
+    return session;
+}
+
+void MemorySessionStorage::expireShard(Shard& shard, std::chrono::system_clock::time_point now,
+                                       std::vector<std::shared_ptr<Session>>& released)
+{
+    const size_t mask = kWheelSize - 1;
+    const int64_t nowTick = std::chrono::duration_cast<std::chrono::seconds>(now.time_since_epoch()).count();
+    size_t budget = kMaxExpirePerShard;
+    // 停顿很久之后，一次最多追赶一圈
+    for (size_t steps = 0; shard.cursor <= nowTick && budget > 0 && steps < kWheelSize; ++steps)
+    {
+        const int64_t tick = shard.cursor;
+        std::vector<SessionKey>& slot = shard.wheel[tick & mask];
+        size_t kept = 0;
+        size_t i = 0;
+        for (; i < slot.size() && budget > 0; ++i, --budget)
+        {
+            auto it = shard.sessions.find(slot[i]);
+            if (it == shard.sessions.end())
+            {
+                continue; // 已经删除
+            }
+            Item& item = it->second;
+            if (item.wheelTick != tick)
+            {
+                // 登记在后面某一圈的同一个槽里，留到那时；否则是重新登记后留下的旧记录
+                if (item.wheelTick > tick && (item.wheelTick & mask) == (tick & mask))
+                {
+                    slot[kept++] = slot[i];
+                }
+                continue;
+            }
+            if (now > item.expiry)
+            {
+                released.push_back(erase(shard, it));
+                continue;
+            }
+            // 期间续期过，按新的过期时间重新登记
+            item.wheelTick = std::max(expiryTick(item.expiry), tick + 1);
+            if ((item.wheelTick & mask) == (tick & mask))
+            {
+                slot[kept++] = slot[i];
+            }
+            else
+            {
+                shard.wheel[item.wheelTick & mask].push_back(slot[i]);
+            }
+        }
+        bool finished = i == slot.size();
+        for (; i < slot.size(); ++i)
+        {
+            slot[kept++] = slot[i];
+        }
+        slot.resize(kept);
+        if (!finished)
+        {
+            break; // 这一秒还没检查完，下次从这里继续
+        }
+        ++shard.cursor;
+    }
+}
+
+}
 }
-}
\ No newline at end of file
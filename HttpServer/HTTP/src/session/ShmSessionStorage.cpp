@@ -0,0 +1,488 @@
+#include "../../include/session/ShmSessionStorage.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <muduo/base/Logging.h>
+
+namespace http
+{
+namespace session
+{
+namespace
+{
+const uint64_t kMagic = 0x53484d5345535331ULL; // "SHMSESS1"
+const int kSpinRetries = 64; // 之后每次重试前让出CPU
+const int kMaxRetries = 1024; // 写锁最多持有几百纳秒，重试这么多次还不行说明写的进程已经崩溃
+const int kMaxSaveRounds = 4;
+const int kOpenWaitMs = 1000; // 等待其他进程初始化共享内存的时间
+
+int64_t nowMs()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+void backoff(int attempt)
+{
+    if (attempt >= kSpinRetries)
+    {
+        std::this_thread::yield();
+    }
+}
+
+uint64_t loadWord(const uint64_t* p)
+{
+    return __atomic_load_n(p, __ATOMIC_RELAXED);
+}
+
+void storeWord(uint64_t* p, uint64_t v)
+{
+    __atomic_store_n(p, v, __ATOMIC_RELAXED);
+}
+
+// 键值对：uint16 键长度 | 键 | uint16 值长度 | 值
+void appendString(std::string& out, const std::string& s)
+{
+    if (s.size() > 0xffff)
+    {
+        throw std::length_error("session value too long for shared memory");
+    }
+    uint16_t len = static_cast<uint16_t>(s.size());
+    out.append(reinterpret_cast<const char*>(&len), sizeof(len));
+    out.append(s);
+}
+
+bool readString(const char*& p, const char* end, std::string* out)
+{
+    uint16_t len;
+    if (end - p < static_cast<ptrdiff_t>(sizeof(len)))
+    {
+        return false;
+    }
+    std::memcpy(&len, p, sizeof(len));
+    p += sizeof(len);
+    if (end - p < len)
+    {
+        return false;
+    }
+    out->assign(p, len);
+    p += len;
+    return true;
+}
+
+size_t roundUpPowerOfTwo(size_t n)
+{
+    size_t result = 1;
+    while (result < n)
+    {
+        result <<= 1;
+    }
+    return result;
+}
+} // namespace
+
+ShmSessionStorage::ShmSessionStorage(const std::string& name, size_t capacity)
+    : name_(name)
+    , bucketCount_(roundUpPowerOfTwo(std::max(capacity + capacity / 4, static_cast<size_t>(kMaxProbe))))
+    , mappedBytes_(sizeof(Header) + bucketCount_ * sizeof(Bucket))
+    , map_(nullptr)
+    , header_(nullptr)
+    , buckets_(nullptr)
+    , expireCursor_(0)
+{
+    bool creator = true;
+    int fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0 && errno == EEXIST)
+    {
+        creator = false;
+        fd = ::shm_open(name.c_str(), O_RDWR, 0600);
+    }
+    if (fd < 0)
+    {
+        throw std::runtime_error("cannot open shared memory " + name + ": " + std::strerror(errno));
+    }
+
+    if (creator)
+    {
+        // 新建的共享内存全是0，即所有的桶都是空的；内存在第一次访问时才真正分配
+        if (::ftruncate(fd, static_cast<off_t>(mappedBytes_)) < 0)
+        {
+            int err = errno;
+            ::close(fd);
+            ::shm_unlink(name.c_str());
+            throw std::runtime_error("cannot size shared memory " + name + ": " + std::strerror(err));
+        }
+    }
+    else
+    {
+        // 创建者可能还没来得及设置大小
+        struct stat st;
+        int waited = 0;
+        while (::fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) < sizeof(Header) && waited < kOpenWaitMs)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            ++waited;
+        }
+        if (static_cast<size_t>(st.st_size) != mappedBytes_)
+        {
+            ::close(fd);
+            throw std::runtime_error("shared memory " + name + " exists with a different capacity");
+        }
+    }
+
+    map_ = ::mmap(nullptr, mappedBytes_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    int err = errno;
+    ::close(fd);
+    if (map_ == MAP_FAILED)
+    {
+        map_ = nullptr;
+        throw std::runtime_error("cannot map shared memory " + name + ": " + std::strerror(err));
+    }
+    header_ = static_cast<Header*>(map_);
+    buckets_ = reinterpret_cast<Bucket*>(static_cast<char*>(map_) + sizeof(Header));
+
+    if (creator)
+    {
+        header_->bucketCount = bucketCount_;
+        header_->bucketBytes = sizeof(Bucket);
+        header_->magic.store(kMagic, std::memory_order_release);
+    }
+    else
+    {
+        int waited = 0;
+        while (header_->magic.load(std::memory_order_acquire) != kMagic && waited < kOpenWaitMs)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            ++waited;
+        }
+        if (header_->magic.load(std::memory_order_acquire) != kMagic
+            || header_->bucketCount != bucketCount_ || header_->bucketBytes != sizeof(Bucket))
+        {
+            ::munmap(map_, mappedBytes_);
+            map_ = nullptr;
+            throw std::runtime_error("shared memory " + name + " is not a compatible session table");
+        }
+    }
+    LOG_INFO << "Session table " << name << (creator ? " created: " : " attached: ")
+             << bucketCount_ << " buckets";
+}
+
+ShmSessionStorage::~ShmSessionStorage()
+{
+    if (map_)
+    {
+        ::munmap(map_, mappedBytes_);
+    }
+}
+
+void ShmSessionStorage::unlink(const std::string& name)
+{
+    ::shm_unlink(name.c_str());
+}
+
+bool ShmSessionStorage::read(const Bucket& b, Snapshot* snap, const SessionKey* key, uint64_t* data) const
+{
+    for (int attempt = 0; attempt < kMaxRetries; ++attempt)
+    {
+        uint64_t seq = b.seq.load(std::memory_order_acquire);
+        if (seq & 1)
+        {
+            backoff(attempt);
+            continue;
+        }
+        uint64_t head = loadWord(&b.words[0]);
+        snap->state = static_cast<uint32_t>(head);
+        snap->dataLength = static_cast<uint32_t>(head >> 32);
+        snap->key.hi = loadWord(&b.words[1]);
+        snap->key.lo = loadWord(&b.words[2]);
+        snap->expiryMs = static_cast<int64_t>(loadWord(&b.words[3]));
+        if (data && snap->state == kUsed && snap->key == *key && snap->dataLength <= kMaxDataBytes)
+        {
+            for (size_t i = 0; i < (snap->dataLength + 7) / 8; ++i)
+            {
+                data[i] = loadWord(&b.words[kHeaderWords + i]);
+            }
+        }
+        // 拷贝完成之后序号没有变，说明期间没有人写
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (b.seq.load(std::memory_order_relaxed) == seq)
+        {
+            return true;
+        }
+        backoff(attempt);
+    }
+    return false;
+}
+
+uint64_t ShmSessionStorage::lock(Bucket& b)
+{
+    for (int attempt = 0; attempt < kMaxRetries; ++attempt)
+    {
+        uint64_t seq = b.seq.load(std::memory_order_relaxed);
+        if (!(seq & 1) && b.seq.compare_exchange_weak(seq, seq + 1, std::memory_order_acquire,
+                                                      std::memory_order_relaxed))
+        {
+            // 之后对数据的写入不能排到序号变成奇数之前
+            std::atomic_thread_fence(std::memory_order_release);
+            return seq + 1;
+        }
+        backoff(attempt);
+    }
+    return 0;
+}
+
+void ShmSessionStorage::unlock(Bucket& b, uint64_t seq)
+{
+    b.seq.store(seq + 1, std::memory_order_release);
+}
+
+void ShmSessionStorage::writeHeader(Bucket& b, State state, uint32_t dataLength, const SessionKey& key, int64_t expiryMs)
+{
+    storeWord(&b.words[0], static_cast<uint64_t>(state) | (static_cast<uint64_t>(dataLength) << 32));
+    storeWord(&b.words[1], key.hi);
+    storeWord(&b.words[2], key.lo);
+    storeWord(&b.words[3], static_cast<uint64_t>(expiryMs));
+}
+
+void ShmSessionStorage::save(std::shared_ptr<Session> session)
+{
+    SessionKey key;
+    if (!SessionKey::parse(session->getId(), &key))
+    {
+        LOG_WARN << "Session id is not a 128-bit hex id, not stored: " << session->getId();
+        return;
+    }
+    std::string bytes;
+    session->forEachValue([&bytes](const std::string& key, const std::string& value)
+    {
+        appendString(bytes, key);
+        appendString(bytes, value);
+    });
+    if (bytes.size() > kMaxDataBytes)
+    {
+        remove(session->getId()); // 不能让其他进程读到旧的数据
+        throw std::length_error("session too large for shared memory: " + std::to_string(bytes.size()) + " bytes");
+    }
+    uint64_t data[kDataWords] = {};
+    std::memcpy(data, bytes.data(), bytes.size());
+    const size_t dataWords = (bytes.size() + 7) / 8;
+    const int64_t expiryMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+        session->expiryTime().time_since_epoch()).count();
+    const size_t home = SessionKeyHash{}(key);
+
+    for (int round = 0; round < kMaxSaveRounds; ++round)
+    {
+        // 先不加锁选出要写的桶：同一个id所在的桶，否则第一个空闲的桶，都没有就覆盖最早过期的
+        const int64_t now = nowMs();
+        size_t target = SIZE_MAX;
+        size_t victim = SIZE_MAX;
+        Snapshot targetSnap{};
+        Snapshot victimSnap{};
+        victimSnap.expiryMs = LLONG_MAX;
+        for (size_t i = 0; i < kMaxProbe; ++i)
+        {
+            Snapshot snap;
+            if (!read(bucket(home + i), &snap, nullptr, nullptr))
+            {
+                continue;
+            }
+            if (snap.state == kUsed && snap.key == key)
+            {
+                target = home + i;
+                targetSnap = snap;
+                break;
+            }
+            if (target == SIZE_MAX && (snap.state != kUsed || snap.expiryMs <= now))
+            {
+                target = home + i;
+                targetSnap = snap;
+            }
+            if (snap.state == kEmpty)
+            {
+                break; // 后面不会再有这个id
+            }
+            if (snap.state == kUsed && snap.expiryMs < victimSnap.expiryMs)
+            {
+                victim = home + i;
+                victimSnap = snap;
+            }
+        }
+        bool evict = false;
+        if (target == SIZE_MAX)
+        {
+            if (victim == SIZE_MAX)
+            {
+                break;
+            }
+            target = victim;
+            targetSnap = victimSnap;
+            evict = true;
+        }
+
+        Bucket& b = bucket(target);
+        uint64_t seq = lock(b);
+        if (seq == 0)
+        {
+            continue;
+        }
+        // 加锁前可能被别的进程改了，改了就重新选
+        Snapshot current;
+        uint64_t head = loadWord(&b.words[0]);
+        current.state = static_cast<uint32_t>(head);
+        current.key.hi = loadWord(&b.words[1]);
+        current.key.lo = loadWord(&b.words[2]);
+        current.expiryMs = static_cast<int64_t>(loadWord(&b.words[3]));
+        if (current.state != targetSnap.state || current.key != targetSnap.key
+            || current.expiryMs != targetSnap.expiryMs)
+        {
+            unlock(b, seq);
+            continue;
+        }
+        writeHeader(b, kUsed, static_cast<uint32_t>(bytes.size()), key, expiryMs);
+        for (size_t i = 0; i < dataWords; ++i)
+        {
+            storeWord(&b.words[kHeaderWords + i], data[i]);
+        }
+        unlock(b, seq);
+        if (evict)
+        {
+            header_->evictions.fetch_add(1, std::memory_order_relaxed);
+        }
+        return;
+    }
+    throw std::runtime_error("cannot store session in shared memory: " + session->getId());
+}
+
+std::shared_ptr<Session> ShmSessionStorage::load(const std::string& sessionId)
+{
+    SessionKey key;
+    if (!SessionKey::parse(sessionId, &key))
+    {
+        return nullptr;
+    }
+    const size_t home = SessionKeyHash{}(key);
+    uint64_t data[kDataWords];
+    for (size_t i = 0; i < kMaxProbe; ++i)
+    {
+        Snapshot snap;
+        if (!read(bucket(home + i), &snap, &key, data))
+        {
+            continue;
+        }
+        if (snap.state == kEmpty)
+        {
+            break;
+        }
+        if (snap.state != kUsed || snap.key != key)
+        {
+            continue;
+        }
+        if (snap.expiryMs <= nowMs() || snap.dataLength > kMaxDataBytes)
+        {
+            return nullptr; // 过期的由cleanExpired改为墓碑
+        }
+
+        auto session = std::make_shared<Session>(key.toString(), nullptr);
+        const char* p = reinterpret_cast<const char*>(data);
+        const char* end = p + snap.dataLength;
+        std::string k;
+        std::string v;
+        while (p < end && readString(p, end, &k) && readString(p, end, &v))
+        {
+            session->setValue(k, v);
+        }
+        session->setExpiryTime(std::chrono::system_clock::time_point(std::chrono::milliseconds(snap.expiryMs)));
+        session->clearDirty(); // 和共享内存中的一致
+        return session;
+    }
+    return nullptr;
+}
+
+void ShmSessionStorage::remove(const std::string& sessionId)
+{
+    SessionKey key;
+    if (!SessionKey::parse(sessionId, &key))
+    {
+        return;
+    }
+    const size_t home = SessionKeyHash{}(key);
+    for (size_t i = 0; i < kMaxProbe; ++i)
+    {
+        Bucket& b = bucket(home + i);
+        Snapshot snap;
+        if (!read(b, &snap, nullptr, nullptr))
+        {
+            continue;
+        }
+        if (snap.state == kEmpty)
+        {
+            break;
+        }
+        if (snap.state != kUsed || snap.key != key)
+        {
+            continue;
+        }
+        uint64_t seq = lock(b);
+        if (seq == 0)
+        {
+            continue;
+        }
+        // 两个进程同时插入同一个id时可能各占一个桶，所以找到后继续往后删
+        if (static_cast<uint32_t>(loadWord(&b.words[0])) == kUsed
+            && loadWord(&b.words[1]) == key.hi && loadWord(&b.words[2]) == key.lo)
+        {
+            writeHeader(b, kDeleted, 0, SessionKey{0, 0}, 0);
+        }
+        unlock(b, seq);
+    }
+}
+
+void ShmSessionStorage::cleanExpired()
+{
+    const int64_t now = nowMs();
+    size_t start = expireCursor_.fetch_add(kMaxExpirePerCall, std::memory_order_relaxed);
+    size_t count = std::min(static_cast<size_t>(kMaxExpirePerCall), bucketCount_);
+    size_t removed = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        Bucket& b = bucket(start + i);
+        Snapshot snap;
+        if (!read(b, &snap, nullptr, nullptr) || snap.state != kUsed || snap.expiryMs > now)
+        {
+            continue;
+        }
+        uint64_t seq = lock(b);
+        if (seq == 0)
+        {
+            continue;
+        }
+        // 期间可能被续期了
+        if (static_cast<uint32_t>(loadWord(&b.words[0])) == kUsed
+            && static_cast<int64_t>(loadWord(&b.words[3])) <= now)
+        {
+            writeHeader(b, kDeleted, 0, SessionKey{0, 0}, 0);
+            ++removed;
+        }
+        unlock(b, seq);
+    }
+    if (removed > 0)
+    {
+        LOG_DEBUG << "Expired sessions removed: " << removed;
+    }
+}
+
+uint64_t ShmSessionStorage::evictions() const
+{
+    return header_->evictions.load(std::memory_order_relaxed);
+}
+}
+}
@@ -0,0 +1,164 @@
+#include "../../include/trace/Tracer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <muduo/base/CurrentThread.h>
+
+namespace http
+{
+namespace trace
+{
+void TraceBuffer::append(const SpanRecord& record)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    slots_[next_ & (kSlots - 1)] = record;
+    ++next_;
+}
+
+void TraceBuffer::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    next_ = 0;
+}
+
+void Tracer::setSampleRate(double rate)
+{
+    rate = std::min(std::max(rate, 0.0), 1.0);
+    sampleThreshold_.store(static_cast<uint64_t>(rate * kSampleAll), std::memory_order_relaxed);
+}
+
+double Tracer::sampleRate() const
+{
+    return static_cast<double>(sampleThreshold_.load(std::memory_order_relaxed)) / kSampleAll;
+}
+
+uint64_t Tracer::sample()
+{
+    uint64_t threshold = sampleThreshold_.load(std::memory_order_relaxed);
+    if (threshold == 0)
+    {
+        return 0;
+    }
+    // 每个线程一个xorshift随机数发生器，不加锁
+    static thread_local uint32_t state = static_cast<uint32_t>(muduo::CurrentThread::tid()) * 2654435761u | 1;
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    if (state >= threshold)
+    {
+        return 0;
+    }
+    return nextTraceId_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Tracer::record(const char* category, const char* name, uint64_t traceId,
+                    muduo::Timestamp start, muduo::Timestamp end, const std::string& detail)
+{
+    if (traceId == 0)
+    {
+        return;
+    }
+    SpanRecord record;
+    record.category = category;
+    record.name = name;
+    record.traceId = traceId;
+    record.startUs = start.microSecondsSinceEpoch();
+    record.durationUs = end.microSecondsSinceEpoch() - record.startUs;
+    size_t len = std::min(detail.size(), SpanRecord::kDetailSize - 1);
+    memcpy(record.detail, detail.data(), len);
+    record.detail[len] = '\0';
+    threadBuffer()->append(record);
+}
+
+TraceBuffer* Tracer::threadBuffer()
+{
+    thread_local TraceBuffer* buffer = nullptr;
+    if (!buffer)
+    {
+        auto newBuffer = std::make_unique<TraceBuffer>(muduo::CurrentThread::tid(), muduo::CurrentThread::name());
+        buffer = newBuffer.get();
+        std::lock_guard<std::mutex> lock(mutex_);
+        buffers_.push_back(std::move(newBuffer));
+    }
+    return buffer;
+}
+
+namespace
+{
+// 字面量和路径里一般不会有特殊字符，这里只处理必须转义的几个
+void appendJsonString(std::string& out, const char* str)
+{
+    out += '"';
+    for (const char* p = str; *p; ++p)
+    {
+        unsigned char c = static_cast<unsigned char>(*p);
+        if (c == '"' || c == '\\')
+        {
+            out += '\\';
+            out += *p;
+        }
+        else if (c < 0x20)
+        {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "\\u%04x", c);
+            out += buf;
+        }
+        else
+        {
+            out += *p;
+        }
+    }
+    out += '"';
+}
+} // namespace
+
+std::string Tracer::exportChromeJson() const
+{
+    std::string out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    char buf[160];
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& buffer : buffers_)
+    {
+        // 线程名，Perfetto按它给每一行命名
+        snprintf(buf, sizeof(buf), "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":",
+                 first ? "" : ",", buffer->tid());
+        out += buf;
+        appendJsonString(out, buffer->threadName().c_str());
+        out += "}}";
+        first = false;
+
+        buffer->forEach([&out, &buffer, &buf](const SpanRecord& record) {
+            // 完整事件（ph=X），时间单位为微秒
+            snprintf(buf, sizeof(buf), ",{\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%lld,\"dur\":%lld,\"cat\":",
+                     buffer->tid(), static_cast<long long>(record.startUs), static_cast<long long>(record.durationUs));
+            out += buf;
+            appendJsonString(out, record.category);
+            out += ",\"name\":";
+            appendJsonString(out, record.name);
+            snprintf(buf, sizeof(buf), ",\"args\":{\"trace\":%llu", static_cast<unsigned long long>(record.traceId));
+            out += buf;
+            if (record.detail[0])
+            {
+                out += ",\"detail\":";
+                appendJsonString(out, record.detail);
+            }
+            out += "}}";
+        });
+    }
+    out += "]}";
+    return out;
+}
+
+void Tracer::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& buffer : buffers_)
+    {
+        buffer->clear();
+    }
+}
+
+} // namespace trace
+} // namespace http
@@ -1,5 +1,6 @@
 #include "../../../include/utils/db/DbConnectionPool.h"
 #include "../../../include/utils/db/DbException.h"
+#include "../../../include/trace/Tracer.h"
 #include <muduo/base/Logging.h>
 
 namespace http 
@@ -64,6 +65,7 @@ std::shared_ptr<DbConnection> DbConnectionPool::getConnection()
 {
     std::shared_ptr<DbConnection> conn;
     {
+        trace::Span span("db", "poolWait");
         std::unique_lock<std::mutex> lock(mutex_);
         
         while (connections_.empty()) 
@@ -72,8 +74,19 @@ std::shared_ptr<DbConnection> DbConnectionPool::getConnection()
             {
                 throw DbException("Connection pool not initialized");
             }
-            LOG_INFO << "Waiting for available connection...";
-            cv_.wait(lock);
+            // 请求设置了截止时间时，最多等到截止时间
+            double remaining = Deadline::remaining();
+            if (remaining < 0)
+            {
+                LOG_INFO << "Waiting for available connection...";
+                cv_.wait(lock);
+            }
+            else
+            {
+                Deadline::check();
+                cv_.wait_for(lock, std::chrono::microseconds(
+                    static_cast<int64_t>(remaining * muduo::Timestamp::kMicroSecondsPerSecond)));
+            }
         }
         
         conn = connections_.front();
@@ -0,0 +1,148 @@
+#include "../../include/view/Template.h"
+
+#include <stdexcept>
+
+namespace http
+{
+namespace view
+{
+namespace
+{
+std::string_view trim(std::string_view s)
+{
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t'))
+    {
+        s.remove_prefix(1);
+    }
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\t'))
+    {
+        s.remove_suffix(1);
+    }
+    return s;
+}
+} // namespace
+
+Template::Template(std::string_view source, std::shared_ptr<const void> owner)
+    : owner_(std::move(owner)), literalSize_(0)
+{
+    size_t pos = 0;
+    while (pos < source.size())
+    {
+        size_t open = source.find("{{", pos);
+        if (open == std::string_view::npos)
+        {
+            open = source.size();
+        }
+        if (open > pos)
+        {
+            segments_.push_back({source.substr(pos, open - pos), -1, false});
+            literalSize_ += open - pos;
+        }
+        if (open == source.size())
+        {
+            break;
+        }
+
+        // {{{name}}}原样插入，{{name}}转义后插入
+        bool raw = open + 2 < source.size() && source[open + 2] == '{';
+        size_t nameStart = open + (raw ? 3 : 2);
+        std::string_view close = raw ? "}}}" : "}}";
+        size_t end = source.find(close, nameStart);
+        if (end == std::string_view::npos)
+        {
+            throw std::invalid_argument("unterminated template placeholder at offset " + std::to_string(open));
+        }
+        std::string_view name = trim(source.substr(nameStart, end - nameStart));
+        if (name.empty())
+        {
+            throw std::invalid_argument("empty template placeholder at offset " + std::to_string(open));
+        }
+        segments_.push_back({std::string_view(), addSlot(name), !raw});
+        pos = end + close.size();
+    }
+}
+
+int Template::slot(std::string_view name) const
+{
+    // 占位符一般只有几个，顺序查找比哈希更快
+    for (size_t i = 0; i < names_.size(); ++i)
+    {
+        if (names_[i] == name)
+        {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+int Template::addSlot(std::string_view name)
+{
+    int index = slot(name);
+    if (index >= 0)
+    {
+        return index;
+    }
+    names_.emplace_back(name);
+    return static_cast<int>(names_.size() - 1);
+}
+
+void Template::render(const Values& values, std::string* out) const
+{
+    size_t size = literalSize_;
+    for (size_t i = 0; i < names_.size(); ++i)
+    {
+        size += values[i].size();
+    }
+    out->reserve(out->size() + size);
+
+    for (const Segment& segment : segments_)
+    {
+        if (segment.slot < 0)
+        {
+            out->append(segment.text.data(), segment.text.size());
+        }
+        else if (segment.escape)
+        {
+            appendEscaped(values[segment.slot], out);
+        }
+        else
+        {
+            out->append(values[segment.slot]);
+        }
+    }
+}
+
+std::string Template::render(const Values& values) const
+{
+    std::string out;
+    render(values, &out);
+    return out;
+}
+
+void Template::appendEscaped(std::string_view text, std::string* out)
+{
+    size_t start = 0;
+    for (size_t i = 0; i < text.size(); ++i)
+    {
+        const char* replacement = nullptr;
+        switch (text[i])
+        {
+            case '&': replacement = "&amp;"; break;
+            case '<': replacement = "&lt;"; break;
+            case '>': replacement = "&gt;"; break;
+            case '"': replacement = "&quot;"; break;
+            case '\'': replacement = "&#39;"; break;
+            default: break;
+        }
+        if (replacement)
+        {
+            out->append(text.data() + start, i - start);
+            out->append(replacement);
+            start = i + 1;
+        }
+    }
+    out->append(text.data() + start, text.size() - start);
+}
+
+} // namespace view
+} // namespace http
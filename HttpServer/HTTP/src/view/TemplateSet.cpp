@@ -0,0 +1,46 @@
+#include "../../include/view/TemplateSet.h"
+
+#include <stdexcept>
+
+#include <muduo/base/Logging.h>
+
+namespace http
+{
+namespace view
+{
+TemplateSet::TemplateSet(std::shared_ptr<const file::StaticFileServer> files)
+    : files_(std::move(files))
+{
+}
+
+std::shared_ptr<const Template> TemplateSet::get(const std::string& name)
+{
+    std::string_view source;
+    std::shared_ptr<const void> owner = files_->content(name, &source);
+    if (!owner)
+    {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    Compiled& cached = templates_[name];
+    if (cached.source == owner)
+    {
+        return cached.tmpl;
+    }
+    cached.source = owner;
+    try
+    {
+        cached.tmpl = std::make_shared<Template>(source, std::move(owner));
+        LOG_INFO << "Template compiled: " << name << " slots=" << cached.tmpl->slotCount();
+    }
+    catch (const std::invalid_argument& e)
+    {
+        LOG_ERROR << "Template " << name << " compile failed: " << e.what();
+        cached.tmpl.reset();
+    }
+    return cached.tmpl;
+}
+
+} // namespace view
+} // namespace http
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <cstdlib>
 #include <ctime>
 #include <vector>
@@ -25,6 +26,9 @@ private:
     int moveCount_; // 移动次数
     std::string winner_{"none"};
     std::pair<int, int> lastMove_{-1, -1}; // 上一步的位置
+    bool searchAborted_ = false; // 搜索因请求超时被中止
+    int searchNodes_ = 0; // 本次搜索访问的节点数，用于间隔检查截止时间
+    std::atomic<bool> inTurn_{false}; // 正在处理一轮落子（AI可能还在计算线程里搜索）
 public:
     AiGame(int userId);
 
@@ -35,11 +39,17 @@ public:
         return moveCount_ >= BOARD_SIZE * BOARD_SIZE;
     }
     
+    // 一轮落子（用户落子加AI落子）开始前调用，上一轮还没有结束时返回false，此时不能修改棋盘
+    bool beginTurn() { return !inTurn_.exchange(true, std::memory_order_acquire); }
+    void endTurn() { inTurn_.store(false, std::memory_order_release); }
+
     bool humanMove(int x, int y); // 用户落子
 
     bool checkwin(int x, int y, const std::string& player); // 判断是否胜利
 
-    void aiMove(); // AI落子
+    void aiMove(); // AI落子，请求超时会中止搜索并抛出http::DeadlineExceeded，棋盘保持不变
+
+    void undoMove(int x, int y); // 撤销一步（AI来不及应对时撤销用户的落子）
 
     std::pair<int, int> getLastMove() const
     {
@@ -6,11 +6,14 @@
 #include <mutex>
 #include <unordered_map>
 
+#include <muduo/base/ThreadPool.h>
+
 #include "AiGame.h"
 #include "../../HTTP/include/http/HttpServer.h"
 #include "../../HTTP/include/utils/MySqlUtil.h"
 #include "../../HTTP/include/utils/JsonUtils.h"
 #include "../../HTTP/include/utils/FileUtils.h"
+#include "../../HTTP/include/view/TemplateSet.h"
 
 
 // 路由处理器的类型定义
@@ -27,6 +30,8 @@ class GameBackendHandler; // 悔棋
 #define GAME_OVER 2 // 游戏结束
 
 #define MAX_AIBOT_NUM 4096 // 最大的机器人数量
+#define MAX_SESSION_NUM 100000 // 内存中最多保存的会话数，超过时淘汰最久没有使用的
+#define AI_THREAD_NUM 4 // AI落子计算线程数
 
 class GomokuServer
 {
@@ -64,15 +69,51 @@ private:
     // 最高在线人数
     std::atomic<int> maxOnline_;
 
+    // 页面文件，全部缓存在内存中，修改后自动重新加载
+    std::string resourceDir_;
+    std::string sessionLog_;
+    std::string sessionKeyFile_;
+    std::string sessionShm_;
+    std::shared_ptr<http::file::StaticFileServer> pages_;
+    // 需要在服务端填入数据的页面，从pages_中的文件编译
+    std::unique_ptr<http::view::TemplateSet> pageTemplates_;
+
+    // 后台数据的响应缓存
+    std::shared_ptr<http::middleware::ResponseCacheMiddleware> responseCache_;
+
+    // 后台统计数据的快照，/backend页面和/backend_data共用，最多每kBackendStatsTtl秒查询一次数据库
+    struct BackendStats
+    {
+        int currentOnline;
+        int maxOnline;
+        int totalUsers;
+    };
+    static constexpr double kBackendStatsTtl = 1.0;
+    // 锁只保护快照的读写，查询数据库时不持锁
+    std::mutex mutexForBackendStats_;
+    BackendStats backendStats_;
+    muduo::Timestamp backendStatsAt_; // 快照的时间，无效时表示还没有查询过
+    bool backendStatsRefreshing_ = false; // 已经有请求在查询，其他请求直接使用旧快照
+
+    // AI落子的计算线程池，放在最后，先于上面的成员析构
+    muduo::ThreadPool aiPool_;
+
 public:
     GomokuServer(int port,
                 const std::string& name,
-                muduo::net::TcpServer::Option option = muduo::net::TcpServer::kNoReusePort); // 不允许重用本地端口
+                muduo::net::TcpServer::Option option = muduo::net::TcpServer::kNoReusePort, // 不允许重用本地端口
+                const std::string& resourceDir = "", // 为空时使用编译进程序的页面
+                const std::string& sessionLog = "", // 会话日志文件，为空时会话只保存在内存中
+                const std::string& sessionKeyFile = "", // 会话签名密钥文件，指定时会话加密保存在cookie中，服务端不保存
+                const std::string& sessionShm = ""); // 会话共享内存的名字，指定时本机的多个进程共享会话
                 // 为什么不允许重用本地端口？
                 // 因为如果允许重用本地端口，那么当服务器重启时，新的服务器实例可能会绑定到相同的端口，这可能导致之前的连接无法正常关闭。
 
     void start(); // 内部初始化服务器
     void setThreadNum(int numThreads);
+    void setCpuAffinity(const http::CpuAffinityConfig& config); // 需要在start()之前调用
+    // 开启热升级，见HttpServer::enableHotUpgrade
+    void enableHotUpgrade(const std::string& controlPath, bool takeOver);
 
 
 private:
@@ -98,6 +139,15 @@ private:
     
     void restartChessGameVsAi(const http::HttpRequest& req, http::HttpResponse* resp); // 重新开始人机对战
     void getBackendData(const http::HttpRequest& req, http::HttpResponse* resp);// 悔棋
+    BackendStats getBackendStats(); // 过期时重新查询（同时只有一个请求查询），查询失败时抛异常
+    void getCacheStats(const http::HttpRequest& req, http::HttpResponse* resp); // 响应缓存的命中情况
+    void getTrace(const http::HttpRequest& req, http::HttpResponse* resp); // 导出调用链追踪数据
+
+    // 返回页面文件，不存在时返回NotFound.html
+    void servePage(const std::string& name, const http::HttpRequest& req, http::HttpResponse* resp);
+    // 把页面作为模板渲染，fill填入占位符的值；模板不可用时按普通页面返回
+    void renderPage(const std::string& name, const http::HttpRequest& req, http::HttpResponse* resp,
+                    const std::function<void(http::view::Template::Values&)>& fill);
 
     // 打包响应: 版本，状态码，状态消息，关闭连接，响应体，响应体类型，响应体长度，响应
     void packageResp(const std::string& version, http::HttpResponse::HttpStatusCode
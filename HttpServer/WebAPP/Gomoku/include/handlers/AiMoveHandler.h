@@ -7,9 +7,20 @@
 class AiMoveHandler : public http::router::RouterHandler
 {
 private:
-    GomokuServer* server_;    
+    GomokuServer* server_;
 public:
     explicit AiMoveHandler(GomokuServer* server) : server_(server) {}
     void handle(const http::HttpRequest& req, http::HttpResponse* resp) override;
-    
+    // AI搜索耗时较长，放到计算线程池里执行，不占用IO线程
+    // 会话、棋局和响应都在IO线程中处理，计算线程只负责AI落子
+    void handleAsync(const http::HttpRequest& req, http::HttpResponse* resp, const Done& done) override;
+
+private:
+    // 检查登录并处理用户落子；需要AI落子时返回棋局，否则已经写好了响应，返回空
+    std::shared_ptr<AiGame> humanTurn(const http::HttpRequest& req, http::HttpResponse* resp, int* userId, int* x, int* y);
+    // AI落子，超时时撤销用户这一步并返回false
+    static bool aiTurn(AiGame& game, int x, int y);
+    // 根据棋局状态写响应，游戏结束时移除棋局
+    void reply(const http::HttpRequest& req, http::HttpResponse* resp, int userId, const AiGame& game, bool aiMoved);
+    void replyError(const http::HttpRequest& req, http::HttpResponse* resp, const std::string& message);
 };
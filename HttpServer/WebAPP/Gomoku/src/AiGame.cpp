@@ -1,4 +1,6 @@
 #include "../include/AiGame.h"
+#include "../../../HTTP/include/http/Deadline.h"
+#include "../../../HTTP/include/trace/Tracer.h"
 #include <muduo/base/Logging.h>
 #include <chrono>
 #include <thread>
@@ -31,6 +33,16 @@ bool AiGame::humanMove(int x, int y)
 
 }
 
+void AiGame::undoMove(int x, int y)
+{
+    if (!isInBoard(x, y) || board_[x][y] == EMPTY) return;
+    board_[x][y] = EMPTY;
+    moveCount_--;
+    lastMove_ = {-1, -1};
+    gameOver_ = false;
+    winner_ = "none";
+}
+
 bool AiGame::checkwin(int x, int y, const std::string& player)
 {
     // 检查行、列、对角线、反对角线
@@ -71,6 +83,12 @@ void AiGame::aiMove()
     int x, y;
     // 选择最佳位置进行移动
     std::tie(x, y) = getBestMove();
+    if (searchAborted_)
+    {
+        // 客户端已经等不到结果了，放弃这次落子
+        http::Deadline::markExceeded();
+        throw http::DeadlineExceeded();
+    }
     board_[x][y] = AI_PLAYER;
     moveCount_++;
     lastMove_ = {x, y};
@@ -108,6 +126,10 @@ int AiGame::evaluateThreat(int r, int c)
 // 评估位置
 std::pair<int, int> AiGame::getBestMove()
 {
+    http::trace::Span span("ai", "search");
+    searchAborted_ = false;
+    searchNodes_ = 0;
+
     for (int i = 0; i < BOARD_SIZE; ++i) {
         for (int j = 0; j < BOARD_SIZE; ++j) {
             if (board_[i][j] == EMPTY) {
@@ -170,6 +192,7 @@ std::pair<int, int> AiGame::getBestMove()
                            std::numeric_limits<int>::min(), 
                            std::numeric_limits<int>::max());
         board_[i][j] = EMPTY;
+        if (searchAborted_) break;
 
         if (score > bestScore) {
             bestScore = score;
@@ -295,6 +318,13 @@ int AiGame::evaluateBoard(const std::vector<std::vector<std::string>> &board, co
 }
 
 int AiGame::minimax(std::vector<std::vector<std::string>>& board, int depth, bool maximizing, int alpha, int beta) {
+    // 每访问64个节点检查一次请求的截止时间，超时后逐层返回，调用方负责恢复棋盘
+    if (searchAborted_) return 0;
+    if ((++searchNodes_ & 0x3f) == 0 && http::Deadline::expired()) {
+        searchAborted_ = true;
+        return 0;
+    }
+
     // 提前终止条件：游戏结束或深度为0
     if (depth == 0 || isGameOver() || isDraw()) {
         return evaluateBoard(board, AI_PLAYER) - evaluateBoard(board, HUMAN_PLAYER);
@@ -330,6 +360,7 @@ int AiGame::minimax(std::vector<std::vector<std::string>>& board, int depth, boo
         board[i][j] = currentPlayer;
         int score = minimax(board, depth - 1, !maximizing, alpha, beta);
         board[i][j] = EMPTY;
+        if (searchAborted_) break;
 
         if (maximizing) {
             best = std::max(best, score);
@@ -12,8 +12,35 @@
 
 using namespace http;
 
-GomokuServer::GomokuServer(int port, const std::string& name, muduo::net::TcpServer::Option option) :
-    server_(port, name, option), maxOnline_(0)
+namespace
+{
+// 路由在编译期就确定了，生成完美哈希表，请求分发时不用构造字符串查哈希表
+constexpr router::StaticRoute kRoutes[] = {
+    {HttpRequest::kGet, "/"},
+    {HttpRequest::kGet, "/entry"},
+    {HttpRequest::kPost, "/login"},
+    {HttpRequest::kPost, "/register"},
+    {HttpRequest::kPost, "/user/logout"},
+    {HttpRequest::kGet, "/menu"},
+    {HttpRequest::kGet, "/aiBot/start"},
+    {HttpRequest::kPost, "/aiBot/move"},
+    {HttpRequest::kGet, "/aiBot/restart"},
+    {HttpRequest::kGet, "/backend"},
+    {HttpRequest::kGet, "/backend_data"},
+    {HttpRequest::kGet, "/backend_cache"},
+    {HttpRequest::kGet, "/admin/trace"},
+};
+constexpr auto kRouteTable = router::makeStaticRouteTable(kRoutes);
+} // namespace
+
+// 构建时由cmake/EmbedResources.cmake根据resource目录生成
+extern const http::file::EmbeddedResourceTable gomokuResources;
+
+GomokuServer::GomokuServer(int port, const std::string& name, muduo::net::TcpServer::Option option,
+                           const std::string& resourceDir, const std::string& sessionLog,
+                           const std::string& sessionKeyFile, const std::string& sessionShm) :
+    server_(port, name, false, option), maxOnline_(0), resourceDir_(resourceDir), sessionLog_(sessionLog),
+    sessionKeyFile_(sessionKeyFile), sessionShm_(sessionShm), aiPool_("AiPool")
 {
     initialize();
 }
@@ -23,8 +50,31 @@ void GomokuServer::setThreadNum(int numThreads)
     server_.setThreadNum(numThreads);
 }
 
+void GomokuServer::setCpuAffinity(const http::CpuAffinityConfig& config)
+{
+    server_.setCpuAffinity(config);
+    if (!config.workerCpus.empty())
+    {
+        // 计算线程在start()中创建，默认继承创建者（还没有绑核的主线程）的CPU掩码，
+        // 所以要在aiPool_.start()之前设置，让每个线程开始执行任务前先把自己绑到workerCpus上
+        std::vector<int> cpus = config.workerCpus;
+        aiPool_.setThreadInitCallback([cpus]() {
+            if (http::CpuAffinity::pinCurrentThread(cpus))
+            {
+                LOG_INFO << "AI worker pinned to " << cpus.size() << " cpu(s), first cpu " << cpus[0];
+            }
+        });
+    }
+}
+
+void GomokuServer::enableHotUpgrade(const std::string& controlPath, bool takeOver)
+{
+    server_.enableHotUpgrade(controlPath, takeOver);
+}
+
 void GomokuServer::start()
 {
+    aiPool_.start(AI_THREAD_NUM);
     server_.start();
 }
 
@@ -41,8 +91,27 @@ void GomokuServer::initialize()
 
 void GomokuServer::initializeSession()
 {
-    // 创建会话存储
-    auto sessionStorage = std::make_unique<http::session::MemorySessionStorage>();
+    // 创建会话存储，指定了日志文件时会话写入磁盘，重启后玩家不用重新登录
+    // 指定了密钥文件时会话只有userId等少量数据，整个加密放在cookie里，多个进程之间不用共享任何东西
+    std::unique_ptr<http::session::SessionStorage> sessionStorage;
+    if (!sessionKeyFile_.empty())
+    {
+        sessionStorage = std::make_unique<http::session::CookieSessionStorage>(
+            http::session::CookieSessionStorage::loadKeys(sessionKeyFile_), true);
+    }
+    else if (!sessionShm_.empty())
+    {
+        // SO_REUSEPORT下同一个玩家的请求会落到不同的进程，会话放在共享内存里大家都能看到
+        sessionStorage = std::make_unique<http::session::ShmSessionStorage>(sessionShm_, MAX_SESSION_NUM);
+    }
+    else if (sessionLog_.empty())
+    {
+        sessionStorage = std::make_unique<http::session::MemorySessionStorage>(MAX_SESSION_NUM);
+    }
+    else
+    {
+        sessionStorage = std::make_unique<http::session::PersistentSessionStorage>(sessionLog_, MAX_SESSION_NUM);
+    }
     if (!sessionStorage)
     {
         LOG_INFO << "Failed to create session storage";
@@ -55,12 +124,21 @@ void GomokuServer::initializeSession()
         LOG_INFO << "Failed to create session manager";
         return;
     }
+    // 没有人再访问的会话也要按时清理
+    sessionManager->startExpiry(server_.getLoop());
     // 设置会话管理器
     server_.setSessionManager(std::move(sessionManager));
 }
 
 void GomokuServer::initializeRouter()
 {
+    server_.useStaticRoutes(kRouteTable);
+    // 页面默认使用编译进程序的版本，不读磁盘；指定了目录时从磁盘读入内存，文件修改后自动重新加载
+    // 都可以通过 /resource/文件名 直接访问
+    pages_ = resourceDir_.empty() ? server_.serveEmbedded("/resource", gomokuResources)
+                                  : server_.serveStatic("/resource", resourceDir_);
+    pageTemplates_ = std::make_unique<http::view::TemplateSet>(pages_);
+    pageTemplates_->get("Backend.html"); // 启动时就编译好，有语法错误也能马上看到
     // 注册路由处理器
     // 入口页面
     server_.Get("/", std::make_shared<EntryHandler>(this));
@@ -88,6 +166,15 @@ void GomokuServer::initializeRouter()
                 {
                     getBackendData(req, resp);
                 });
+    server_.Get("/backend_cache", [this](const HttpRequest& req, HttpResponse* resp)
+                {
+                    getCacheStats(req, resp);
+                });
+    // 调用链追踪，用chrome://tracing或者Perfetto打开
+    server_.Get("/admin/trace", [this](const HttpRequest& req, HttpResponse* resp)
+                {
+                    getTrace(req, resp);
+                });
     // this 是什么？
     // this 是一个指向当前对象的指针，它指向当前对象的内存地址。在这个例子中，this 指向 GomokuServer 对象。
 }
@@ -101,8 +188,28 @@ void GomokuServer::initializeMiddleware()
         LOG_INFO << "Failed to create middleware";
         return;
     }
-    
-    server_.addMiddleware(middleware);
+
+    // 页面和静态资源不需要跨域头，只挂在接口上
+    // 挂在全局的限流外面，被限流的429也带跨域头，浏览器里的脚本才能读到状态码
+    for (const char* prefix : {"/login", "/register", "/user", "/aiBot", "/backend_data"})
+    {
+        server_.addOuterMiddleware(prefix, middleware);
+    }
+
+    // 限流：所有请求按IP限制；AI落子每次都要搜索，再按会话单独限制得更严
+    auto rateLimiter = std::make_shared<http::middleware::RateLimitMiddleware>(
+        http::middleware::RateLimitPolicy::perIp(50, 100));
+    rateLimiter->addRoutePolicy("/aiBot/move", http::middleware::RateLimitPolicy::perSession(2, 5));
+    rateLimiter->setSessionManager(getSessionManager());
+    rateLimiter->addRoutePolicy("/login", http::middleware::RateLimitPolicy::perIp(1, 10));
+    rateLimiter->startExpiry(server_.getLoop());
+    server_.addMiddleware(rateLimiter);
+
+    // 后台数据每次都要查数据库，缓存一小段时间（页面已经在内存中，不需要缓存）
+    // 缓存要在CORS之后添加，命中时CORS仍然会给响应加上跨域头
+    responseCache_ = std::make_shared<http::middleware::ResponseCacheMiddleware>();
+    responseCache_->cacheRoute("/backend_data", kBackendStatsTtl);
+    server_.addMiddleware("/backend_data", responseCache_);
 }
 
 void GomokuServer::restartChessGameVsAi(const HttpRequest& req, HttpResponse* resp)
@@ -112,7 +219,7 @@ void GomokuServer::restartChessGameVsAi(const HttpRequest& req, HttpResponse* re
     // 如果是第一次建立连接，那么就创建一个新的会话
     auto session = getSessionManager()->getSession(req,resp);
 
-    if (session->getValue("isLoggedIn") != "true")
+    if (!session->isLoggedIn())
     {
         json errResp;
         errResp["status"] = "error";
@@ -125,7 +232,7 @@ void GomokuServer::restartChessGameVsAi(const HttpRequest& req, HttpResponse* re
         return;
     }
 
-    int userId = std::stoi(session->getValue("userId"));
+    int userId = static_cast<int>(session->userId());
     {
         // 重新开始ai对战
         std::lock_guard<std::mutex> lock(mutexForAiGames_);
@@ -146,27 +253,140 @@ void GomokuServer::restartChessGameVsAi(const HttpRequest& req, HttpResponse* re
                , "OK", true, "application/json", successBody, successBody.length(), resp);
 }
 
-// 获取后台数据
-void GomokuServer::getBackendData(const HttpRequest& req, HttpResponse* resp)
+void GomokuServer::getCacheStats(const HttpRequest& req, HttpResponse* resp)
+{
+    http::middleware::ResponseCacheMiddleware::Stats stats = responseCache_->stats();
+    nlohmann::json respBody = {
+        {"hits", stats.hits},
+        {"misses", stats.misses},
+        {"coalesced", stats.coalesced},
+        {"evictions", stats.evictions},
+        {"entries", stats.entries},
+        {"bytes", stats.bytes}
+    };
+    std::string respBodyStr = respBody.dump(4);
+    resp->setStatusLine(HttpResponse::k200Ok, "OK", req.getVersion());
+    resp->setContentType("application/json");
+    resp->setBody(respBodyStr);
+    resp->setContentLength(respBodyStr.length());
+    resp->setCloseConnection(false);
+}
+
+void GomokuServer::servePage(const std::string& name, const HttpRequest& req, HttpResponse* resp)
 {
+    if (pages_->serveFile(name, req, resp))
+    {
+        return;
+    }
+    LOG_WARN << "文件不存在:" << name;
+    if (pages_->serveFile("NotFound.html", req, resp) && resp->getStatusCode() == HttpResponse::k200Ok)
+    {
+        resp->setStatusLine(HttpResponse::k404NotFound, "Not Found", req.getVersion());
+        return;
+    }
+    resp->clearPreformatted();
+    resp->setStatusLine(HttpResponse::k404NotFound, "Not Found", req.getVersion());
+    resp->setContentLength(0);
+}
+
+void GomokuServer::renderPage(const std::string& name, const HttpRequest& req, HttpResponse* resp,
+                              const std::function<void(http::view::Template::Values&)>& fill)
+{
+    std::shared_ptr<const http::view::Template> page = pageTemplates_->get(name);
+    if (!page)
+    {
+        servePage(name, req, resp);
+        return;
+    }
+    http::view::Template::Values values(*page);
+    fill(values);
+    std::string body = page->render(values);
+
+    resp->setStatusLine(HttpResponse::k200Ok, "OK", req.getVersion());
+    resp->setContentType("text/html; charset=utf-8");
+    resp->addHeader("Cache-Control", "no-store"); // 内容每次都不同
+    resp->setContentLength(body.size());
+    resp->setBody(std::move(body));
+    resp->setCloseConnection(false);
+}
+
+// 只允许本机访问；带上clear=1时导出后清空
+void GomokuServer::getTrace(const HttpRequest& req, HttpResponse* resp)
+{
+    if (req.remoteAddr() != "127.0.0.1" && req.remoteAddr() != "::1")
+    {
+        resp->setStatusLine(HttpResponse::k403Forbidden, "Forbidden", req.getVersion());
+        resp->setContentLength(0);
+        resp->setCloseConnection(true);
+        return;
+    }
+    http::trace::Tracer& tracer = http::trace::Tracer::getInstance();
+    std::string respBodyStr = tracer.exportChromeJson();
+    if (req.getQueryParameters("clear") == "1")
+    {
+        tracer.clear();
+    }
+    resp->setStatusLine(HttpResponse::k200Ok, "OK", req.getVersion());
+    resp->setContentType("application/json");
+    resp->setBody(respBodyStr);
+    resp->setContentLength(respBodyStr.length());
+    resp->setCloseConnection(false);
+}
+
+GomokuServer::BackendStats GomokuServer::getBackendStats()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutexForBackendStats_);
+        muduo::Timestamp now = muduo::Timestamp::now();
+        if (backendStatsAt_.valid() && muduo::timeDifference(now, backendStatsAt_) < kBackendStatsTtl)
+        {
+            return backendStats_;
+        }
+        // 已经有请求在查询时返回旧快照，不让IO线程等待数据库；还没有快照时只能自己查询
+        if (backendStatsRefreshing_ && backendStatsAt_.valid())
+        {
+            return backendStats_;
+        }
+        backendStatsRefreshing_ = true;
+    }
+
+    BackendStats stats;
     try
     {
-        int curOnline = getCurrentOnline();
-        LOG_INFO << "当前在线人数:" << curOnline;
+        stats.currentOnline = getCurrentOnline();
+        stats.maxOnline = getMaxOnline();
+        stats.totalUsers = getUserTotal();
+    }
+    catch (...)
+    {
+        std::lock_guard<std::mutex> lock(mutexForBackendStats_);
+        backendStatsRefreshing_ = false;
+        throw;
+    }
+    LOG_INFO << "当前在线人数:" << stats.currentOnline << " 最高在线人数:" << stats.maxOnline
+             << " 总用户数:" << stats.totalUsers;
 
-        int maxOnline = getMaxOnline();
-        LOG_INFO << "最高在线人数:" << maxOnline;
+    std::lock_guard<std::mutex> lock(mutexForBackendStats_);
+    backendStats_ = stats;
+    backendStatsAt_ = muduo::Timestamp::now();
+    backendStatsRefreshing_ = false;
+    return stats;
+}
 
-        int totalUsers = getUserTotal();
-        LOG_INFO << "总用户数:" << totalUsers;
+// 获取后台数据
+void GomokuServer::getBackendData(const HttpRequest& req, HttpResponse* resp)
+{
+    try
+    {
+        BackendStats stats = getBackendStats();
 
         // 构造json响应
         // json响应是用来返回给客户端的数据，客户端可以根据这个数据来更新页面
         nlohmann::json respBody;
         respBody = {
-            {"currentOnline", curOnline},
-            {"maxOnline", maxOnline},
-            {"totalUsers", totalUsers}
+            {"currentOnline", stats.currentOnline},
+            {"maxOnline", stats.maxOnline},
+            {"totalUsers", stats.totalUsers}
         };
 
         // 转换成字符串
@@ -223,7 +443,7 @@ void GomokuServer::packageResp(const std::string &version,
         resp->setStatusMessage(statusMessage);
         resp->setCloseConnection(close);
 
-        LOG_INFO << "resp panckage successfully";
+        LOG_DEBUG << "resp panckage successfully";
     }
     catch(const std::exception& e)
     {
@@ -1,194 +1,267 @@
 #include "../../include/handlers/AiMoveHandler.h"
 #include <muduo/base/Logging.h>
-// ai下棋
-void AiMoveHandler::handle(const http::HttpRequest& req, http::HttpResponse* resp) 
+#include <muduo/net/EventLoop.h>
+
+void AiMoveHandler::handleAsync(const http::HttpRequest& req, http::HttpResponse* resp, const Done& done)
 {
+    int userId = 0;
+    int x = 0;
+    int y = 0;
+    std::shared_ptr<AiGame> game;
     try
     {
-        // 获取会话
-        auto session = server_->getSessionManager()->getSession(req, resp);
-        // 检查是否登录
-        if (session->getValue("isLoggedIn") != "true")
-        {
-            json errResp;
-            errResp["status"] = "error";
-            errResp["message"] = "Unauthorized";
-            std::string errorBody = errResp.dump(4); // 将json对象转换为字符串
-            // 构建响应返回错误信息，未登录
-            server_->packageResp(req.getVersion(), http::HttpResponse::k401Unauthorized
-                        , "Unauthorized", true, "application/json", errorBody, errorBody.length(), resp);
-            return;
-        }
-        LOG_INFO << "开始处理移动";
-        int userId = std::stoi(session->getValue("userId"));
-        // 解析请求体
-        json request = json::parse(req.getBody());
-        // 检查请求体是否包含x和y坐标
-
-        int x = request["x"];
-        int y = request["y"];
-
-        if (server_->game_map_.find(userId) == server_->game_map_.end())
-        {
-            std::lock_guard<std::mutex> lock(server_->mutexForAiGames_);
-            server_->game_map_[userId] = std::make_shared<AiGame>(userId);
-        }
-        auto &game = server_->game_map_[userId];
-        // 处理用户的移动
-        if (!game->humanMove(x, y))
-        {
-            LOG_ERROR << "用户移动失败";
-            json errResp =
-            {
-                {"status", "error"},
-                {"message", "Invalid move"}
-            };
-            std::string errorBody = errResp.dump(); // 将json对象转换为字符串
-            // 构建响应返回错误信息，无效的移动
-            resp->setStatusLine(http::HttpResponse::k400BadRequest, "Bad Request",req.getVersion());
-            resp->setCloseConnection(false);
-            resp->setContentType("application/json");
-            resp->setContentLength(errorBody.size());
-            resp->setBody(errorBody);
-            return;
-        }
-        LOG_INFO << "用户移动成功";
+        game = humanTurn(req, resp, &userId, &x, &y);
+    }
+    catch (const std::exception& e)
+    {
+        replyError(req, resp, e.what());
+    }
+    if (!game)
+    {
+        done();
+        return;
+    }
 
-        // 检查游戏是否结束
-        if (game->isGameOver())
+    // 计算线程只做AI搜索，完成后回到当前IO线程写响应
+    muduo::net::EventLoop* loop = muduo::net::EventLoop::getEventLoopOfCurrentThread();
+    muduo::Timestamp deadline = req.deadline();
+    uint64_t traceId = req.traceId();
+    server_->aiPool_.run([this, &req, resp, done, loop, game, userId, x, y, deadline, traceId]() {
+        bool moved = false;
+        std::string error;
         {
-            json respBody =
+            // 截止时间是线程局部的，在计算线程里重新设置
+            http::Deadline::Scope scope(deadline);
+            http::trace::Tracer::Scope trace(traceId);
+            http::trace::Span span("handler", "aiMove");
+            try
             {
-                {"status", "ok"},
-                {"board", game->getBoard()},
-                {"winner", game->getWinner()},
-                {"next_turn", "none"}
-            };
-            std::string respBodyStr = respBody.dump(); // 将json对象转换为字符串
-            // 构建响应返回成功信息
-            resp->setStatusLine(http::HttpResponse::k200Ok, "OK",req.getVersion());
-            resp->setCloseConnection(false);
-            resp->setContentType("application/json");
-            resp->setContentLength(respBodyStr.size());
-            resp->setBody(respBodyStr);
-            {
-                std::lock_guard<std::mutex> lock(server_->mutexForAiGames_);
-                server_->game_map_.erase(userId);// 反正每次都要创建userid
+                moved = aiTurn(*game, x, y);
             }
-            return;
-        }
-
-        // 检查平局
-        if (game->isDraw())
-        {
-            json respBody =
+            catch (const std::exception& e)
             {
-                {"status", "ok"},
-                {"board", game->getBoard()},
-                {"winner", "draw"},
-                {"next_turn", "none"}
-                
-            };
-            std::string respBodyStr = respBody.dump(); // 将json对象转换为字符串
-            // 构建响应返回成功信息
-
-            resp->setStatusLine(http::HttpResponse::k200Ok, "OK",req.getVersion());
-            resp->setCloseConnection(false);
-            resp->setContentType("application/json");
-            resp->setContentLength(respBodyStr.size());
-            resp->setBody(respBodyStr);
-            {
-                std::lock_guard<std::mutex> lock(server_->mutexForAiGames_);
-                server_->game_map_.erase(userId);// 反正每次都要创建userid
+                error = e.what();
             }
-            return;
         }
-        // AI移动
-        LOG_INFO << "AI开始移动";
-        game->aiMove();
-        LOG_INFO << "ai移动成功";
-        // 检查游戏是否结束
-        if (game->isGameOver())
-        {
-            json respBody =
+        // 请求已经超时结束时这里写的响应不会再发送，done也不再有效果
+        loop->runInLoop([this, &req, resp, done, game, userId, moved, error]() {
+            try
             {
-                {"status", "ok"},
-                {"board", game->getBoard()},
-                {"winner", game->getWinner()},
-                {"next_turn", "none"},
-                {"last_move", {{"x", game->getLastMove().first}, {"y", game->getLastMove().second}}}
-            };
-            std::string respBodyStr = respBody.dump(); // 将json对象转换为字符串
-            // 构建响应返回成功信息
-            resp->setStatusLine(http::HttpResponse::k200Ok, "OK",req.getVersion());
-            resp->setCloseConnection(false);
-            resp->setContentType("application/json");
-            resp->setContentLength(respBodyStr.size());
-            resp->setBody(respBodyStr);    
+                if (!error.empty())
+                {
+                    replyError(req, resp, error);
+                }
+                else if (!moved)
+                {
+                    resp->setGatewayTimeout(req.getVersion());
+                }
+                else
+                {
+                    reply(req, resp, userId, *game, true);
+                }
+            }
+            catch (const std::exception& e)
             {
-                std::lock_guard<std::mutex> lock(server_->mutexForAiGames_);
-                server_->game_map_.erase(userId);// 反正每次都要创建userid
+                replyError(req, resp, e.what());
             }
+            game->endTurn();
+            done();
+        });
+    });
+}
 
+// ai下棋
+void AiMoveHandler::handle(const http::HttpRequest& req, http::HttpResponse* resp)
+{
+    int userId = 0;
+    int x = 0;
+    int y = 0;
+    std::shared_ptr<AiGame> game;
+    try
+    {
+        game = humanTurn(req, resp, &userId, &x, &y);
+        if (!game)
+        {
             return;
-
         }
-        // 检查平局
-        if (game->isDraw())
+        if (aiTurn(*game, x, y))
         {
-            json respBody =
-            {
-                {"status", "ok"},
-                {"board", game->getBoard()},
-                {"winner", "draw"},
-                {"next_turn", "none"},
-                {"last_move", {{"x", game->getLastMove().first}, {"y", game->getLastMove().second}}}
-            };
-            std::string respBodyStr = respBody.dump(); // 将json对象转换为字符串
-            // 构建响应返回成功信息
-            resp->setStatusLine(http::HttpResponse::k200Ok, "OK",req.getVersion());
-            resp->setCloseConnection(false);
-            resp->setContentType("application/json");
-            resp->setContentLength(respBodyStr.size());
-            resp->setBody(respBodyStr);
-            {
-                std::lock_guard<std::mutex> lock(server_->mutexForAiGames_);
-                server_->game_map_.erase(userId);// 反正每次都要创建userid
-            }
-            return;
+            reply(req, resp, userId, *game, true);
+        }
+        else
+        {
+            resp->setGatewayTimeout(req.getVersion());
         }
+    }
+    catch(const std::exception& e)
+    {
+        replyError(req, resp, e.what());
+    }
+    if (game)
+    {
+        game->endTurn();
+    }
+}
 
+std::shared_ptr<AiGame> AiMoveHandler::humanTurn(const http::HttpRequest& req, http::HttpResponse* resp,
+                                                 int* userId, int* x, int* y)
+{
+    // 获取会话
+    auto session = server_->getSessionManager()->getSession(req, resp);
+    // 检查是否登录
+    if (!session->isLoggedIn())
+    {
+        json errResp;
+        errResp["status"] = "error";
+        errResp["message"] = "Unauthorized";
+        std::string errorBody = errResp.dump(4); // 将json对象转换为字符串
+        // 构建响应返回错误信息，未登录
+        server_->packageResp(req.getVersion(), http::HttpResponse::k401Unauthorized
+                    , "Unauthorized", true, "application/json", errorBody, errorBody.length(), resp);
+        return nullptr;
+    }
+    LOG_INFO << "开始处理移动";
+    *userId = static_cast<int>(session->userId());
+    // 解析请求体
+    json request = json::parse(req.getBody());
+    *x = request["x"];
+    *y = request["y"];
 
-        // 游戏继续
-        LOG_INFO << "游戏继续";
-        json respBody =
+    std::shared_ptr<AiGame> game;
+    {
+        std::lock_guard<std::mutex> lock(server_->mutexForAiGames_);
+        std::shared_ptr<AiGame>& slot = server_->game_map_[*userId];
+        if (!slot)
+        {
+            slot = std::make_shared<AiGame>(*userId);
+        }
+        game = slot;
+    }
+    if (!game->beginTurn())
+    {
+        // 上一步的AI还在计算线程里搜索，不能修改棋盘
+        json errResp =
         {
-            {"status", "ok"},
-            {"board", game->getBoard()},
-            {"winner", "none"},
-            {"next_turn", "human"},
-            {"last_move", {{"x", game->getLastMove().first}, {"y", game->getLastMove().second}}}
+            {"status", "error"},
+            {"message", "AI is still thinking"}
         };
-        std::string respBodyStr = respBody.dump(); // 将json对象转换为字符串
-        // 构建响应返回成功信息
-        resp->setStatusLine(http::HttpResponse::k200Ok, "OK",req.getVersion());
+        std::string errorBody = errResp.dump();
+        resp->setStatusLine(http::HttpResponse::k409Conflict, "Conflict", req.getVersion());
         resp->setCloseConnection(false);
         resp->setContentType("application/json");
-        resp->setContentLength(respBodyStr.size());
-        resp->setBody(respBodyStr);
+        resp->setContentLength(errorBody.size());
+        resp->setBody(errorBody);
+        return nullptr;
     }
-    catch(const std::exception& e)
+    // 处理用户的移动
+    if (!game->humanMove(*x, *y))
     {
-        LOG_ERROR << "ai移动失败:" << e.what();
+        game->endTurn();
+        LOG_ERROR << "用户移动失败";
         json errResp =
         {
             {"status", "error"},
-            {"message", e.what()}
+            {"message", "Invalid move"}
         };
         std::string errorBody = errResp.dump(); // 将json对象转换为字符串
-        // 构建响应返回错误信息
-        server_->packageResp(req.getVersion(), http::HttpResponse::k500InternalServerError
-                   , "Internal Server Error", false, "application/json", errorBody, errorBody.length(), resp);
+        // 构建响应返回错误信息，无效的移动
+        resp->setStatusLine(http::HttpResponse::k400BadRequest, "Bad Request",req.getVersion());
+        resp->setCloseConnection(false);
+        resp->setContentType("application/json");
+        resp->setContentLength(errorBody.size());
+        resp->setBody(errorBody);
+        return nullptr;
+    }
+    LOG_INFO << "用户移动成功";
 
+    // 检查游戏是否结束或者平局，结束后棋盘不会再变化
+    if (game->isGameOver() || game->isDraw())
+    {
+        game->endTurn();
+        reply(req, resp, *userId, *game, false);
+        return nullptr;
+    }
+    return game;
+}
+
+bool AiMoveHandler::aiTurn(AiGame& game, int x, int y)
+{
+    // AI移动
+    LOG_INFO << "AI开始移动";
+    try
+    {
+        game.aiMove();
     }
-}
\ No newline at end of file
+    catch (const http::DeadlineExceeded&)
+    {
+        // AI没能在截止时间内落子，撤销用户这一步，让用户重新下
+        game.undoMove(x, y);
+        return false;
+    }
+    LOG_INFO << "ai移动成功";
+    return true;
+}
+
+void AiMoveHandler::reply(const http::HttpRequest& req, http::HttpResponse* resp, int userId,
+                          const AiGame& game, bool aiMoved)
+{
+    json respBody =
+    {
+        {"status", "ok"},
+        {"board", game.getBoard()}
+    };
+    bool over = true;
+    if (game.isGameOver())
+    {
+        respBody["winner"] = game.getWinner();
+        respBody["next_turn"] = "none";
+    }
+    else if (game.isDraw())
+    {
+        respBody["winner"] = "draw";
+        respBody["next_turn"] = "none";
+    }
+    else
+    {
+        // 游戏继续
+        LOG_INFO << "游戏继续";
+        respBody["winner"] = "none";
+        respBody["next_turn"] = "human";
+        over = false;
+    }
+    if (aiMoved)
+    {
+        respBody["last_move"] = {{"x", game.getLastMove().first}, {"y", game.getLastMove().second}};
+    }
+    std::string respBodyStr = respBody.dump(); // 将json对象转换为字符串
+    // 构建响应返回成功信息
+    resp->setStatusLine(http::HttpResponse::k200Ok, "OK",req.getVersion());
+    resp->setCloseConnection(false);
+    resp->setContentType("application/json");
+    resp->setContentLength(respBodyStr.size());
+    resp->setBody(respBodyStr);
+    if (over)
+    {
+        std::lock_guard<std::mutex> lock(server_->mutexForAiGames_);
+        auto it = server_->game_map_.find(userId);
+        // 期间用户可能已经开始了新的一局
+        if (it != server_->game_map_.end() && it->second.get() == &game)
+        {
+            server_->game_map_.erase(it);
+        }
+    }
+}
+
+void AiMoveHandler::replyError(const http::HttpRequest& req, http::HttpResponse* resp, const std::string& message)
+{
+    LOG_ERROR << "ai移动失败:" << message;
+    json errResp =
+    {
+        {"status", "error"},
+        {"message", message}
+    };
+    std::string errorBody = errResp.dump(); // 将json对象转换为字符串
+    // 构建响应返回错误信息
+    server_->packageResp(req.getVersion(), http::HttpResponse::k500InternalServerError
+               , "Internal Server Error", false, "application/json", errorBody, errorBody.length(), resp);
+}
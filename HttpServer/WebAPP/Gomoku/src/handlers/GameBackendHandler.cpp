@@ -3,26 +3,13 @@
 
 void GameBackendHandler::handle(const http::HttpRequest& req, http::HttpResponse* resp)
 {
-    // 展示后台界面
-    std::string reqFile("/home/yebidang/workplace/HttpServer/WebAPP/Gomoku/resource/Backend.html");
-    FileUtil fileUtils(reqFile);
-    if (!fileUtils.isValid())
+    // 展示后台界面，统计数据直接渲染进页面，打开页面时不用再请求一次/backend_data
+    // 和/backend_data用同一份快照，频繁刷新页面不会每次都查询数据库
+    GomokuServer::BackendStats stats = server_->getBackendStats();
+    server_->renderPage("Backend.html", req, resp, [&stats](http::view::Template::Values& values)
     {
-        LOG_WARN << reqFile << " is not a valid file";
-        fileUtils.resetDefaultFile();
-    }
-
-    std::vector<char> buffer(fileUtils.size());
-    fileUtils.readFile(buffer); // 读取文件内容到buffer
-    std::string buf = std::string(buffer.data(), buffer.size());
-
-    // 构建响应返回信息
-    resp->setStatusLine(http::HttpResponse::k200Ok, "OK", req.getVersion());
-    resp->setContentType("text/html");
-    resp->setContentLength(buf.size());
-    resp->setBody(buf);
-    resp->setCloseConnection(false);
-
-    return;
-
+        values.set("currentOnline", std::to_string(stats.currentOnline));
+        values.set("maxOnline", std::to_string(stats.maxOnline));
+        values.set("totalUsers", std::to_string(stats.totalUsers));
+    });
 }
\ No newline at end of file
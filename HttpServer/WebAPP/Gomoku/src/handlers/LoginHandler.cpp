@@ -33,9 +33,9 @@ void LoginHandler::handle(const http::HttpRequest &req, http::HttpResponse *resp
             // 那么判断用户是否在其他地方登录中不能通过会话来判断
             
             // 在会话中存储用户信息
-            session->setValue("userId", std::to_string(userId));
-            session->setValue("username", username);
-            session->setValue("isLoggedIn", "true");
+            session->setUserId(userId);
+            session->setUsername(username);
+            session->setLoggedIn(true);
             if (server_->online_users.find(userId) == server_->online_users.end() || server_->online_users[userId] == false)
             {
                 {
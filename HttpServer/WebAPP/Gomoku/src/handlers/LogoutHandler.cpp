@@ -17,9 +17,20 @@ void LogoutHandler::handle(const http::HttpRequest& req, http::HttpResponse* res
     {
         // 获取会话
         auto session = server_->getSessionManager()->getSession(req, resp);
-        int userId = std::stoi(session->getValue("userId"));
+        // 没有登录过的会话userId()为0，不能拿它去清理别人的在线状态和对局
+        if (!session->hasUserId())
+        {
+            json errResp;
+            errResp["status"] = "error";
+            errResp["message"] = "Unauthorized";
+            std::string errorBody = errResp.dump(4);
+            server_->packageResp(req.getVersion(), http::HttpResponse::k401Unauthorized
+                        , "Unauthorized", true, errorBody, "application/json", errorBody.length(), resp);
+            return;
+        }
+        int userId = static_cast<int>(session->userId());
         session->clear(); // 清除的内容不包含sessionid
-        server_->getSessionManager()->destroySession(session->getId());
+        server_->getSessionManager()->destroySession(session);
         
         json parsed = json::parse(req.getBody());
         int gameType = parsed["gameType"];
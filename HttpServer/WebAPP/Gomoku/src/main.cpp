@@ -12,13 +12,32 @@ int main(int argc, char* argv[])
   
   std::string serverName = "HttpServer";
   int port = 8080;
+  std::string accessLogName = "gomoku_access"; // 访问日志文件名前缀
+  bool upgradable = false; // 热升级：允许以后的新进程接管本进程的监听套接字
+  bool takeOver = false; // 热升级：从正在运行的旧进程接管监听套接字
+  http::CpuAffinityConfig cpuAffinity; // 绑核配置，默认不绑
+  double traceSampleRate = 0; // 调用链追踪的采样率，默认不追踪
+  std::string resourceDir; // 页面文件目录，默认使用编译进程序的页面
+  std::string sessionLog; // 会话日志文件，默认不持久化
+  std::string sessionKeyFile; // 会话cookie的密钥文件，默认会话保存在服务端
+  std::string sessionShm; // 会话共享内存的名字，默认每个进程各自保存会话
   
   // 参数解析
-  // p:port
-  // 例如:./HttpServer -p 8080
+  // p:port a:访问日志文件名前缀
+  // U:允许热升级，开启SO_REUSEPORT并在控制套接字上等待新进程；不指定时同一端口上误启动的第二个实例会bind失败
+  // u:热升级，从以-U（或-u）启动的旧进程接管监听套接字，本进程之后也可以被热升级
+  // c:主循环的CPU列表 i:各IO线程的CPU集合，用冒号分隔 w:AI计算线程池的CPU列表，避免和IO线程抢同一批核
+  // t:调用链追踪的采样率（0~1），结果从本机访问/admin/trace导出
+  // r:页面文件目录，从磁盘读取并在修改后自动重新加载，开发页面时使用
+  // s:会话日志文件，重启后会话仍然有效；同一个日志只能由一个进程使用，不能和-u一起使用
+  //   （交接期间新旧进程同时在运行），需要热升级时改用-m
+  // k:会话密钥文件，每行"id 密钥"，第一行用于签发，会话加密保存在cookie中（指定后忽略-m和-s）
+  // m:会话共享内存的名字（如/gomoku_sessions），本机用同一个名字的进程共享会话（指定后忽略-s）
+  //   同时开启SO_REUSEPORT，多个进程监听同一个端口；这时不要再用-U，第二个进程会因为控制套接字已被占用而拒绝启动
+  // 例如:./HttpServer -p 8080 -a gomoku_access -U -c 0 -i 1:2:3:4 -w 5-7 -t 0.01 -r ./resource -s gomoku_sessions.log
   
   int opt;
-  const char* str = "p:"; // p:表示p后面需要跟一个参数
+  const char* str = "p:a:Uuc:i:w:t:r:s:k:m:"; // p:表示p后面需要跟一个参数
   while ((opt = getopt(argc, argv, str)) != -1) // 解析命令行参数
   {
     switch (opt)
@@ -28,16 +47,104 @@ int main(int argc, char* argv[])
         port = atoi(optarg);
         break;
       }
+      case 'a':
+      {
+        accessLogName = optarg;
+        break;
+      }
+      case 'U':
+      {
+        upgradable = true;
+        break;
+      }
+      case 'u':
+      {
+        takeOver = true;
+        upgradable = true;
+        break;
+      }
+      case 'c':
+      case 'i':
+      case 'w':
+      {
+        try
+        {
+          if (opt == 'c')
+          {
+            cpuAffinity.acceptCpus = http::CpuAffinity::parseCpuList(optarg);
+          }
+          else if (opt == 'i')
+          {
+            cpuAffinity.ioLoopCpus = http::CpuAffinity::parseCpuSets(optarg);
+          }
+          else
+          {
+            cpuAffinity.workerCpus = http::CpuAffinity::parseCpuList(optarg);
+          }
+        }
+        catch (const std::invalid_argument& e)
+        {
+          std::cerr << "-" << static_cast<char>(opt) << ": " << e.what() << std::endl;
+          return 1;
+        }
+        break;
+      }
+      case 't':
+      {
+        traceSampleRate = atof(optarg);
+        break;
+      }
+      case 'r':
+      {
+        resourceDir = optarg;
+        break;
+      }
+      case 's':
+      {
+        sessionLog = optarg;
+        break;
+      }
+      case 'k':
+      {
+        sessionKeyFile = optarg;
+        break;
+      }
+      case 'm':
+      {
+        sessionShm = optarg;
+        break;
+      }
       default:
         break;
     }
   }
 
+  // 热升级时旧进程还在排空请求、写入会话日志，新进程不能同时打开它（-k和-m会让-s失效）
+  if (takeOver && !sessionLog.empty() && sessionKeyFile.empty() && sessionShm.empty())
+  {
+    std::cerr << "-s cannot be used with -u: the old process keeps writing the session log while it drains, "
+                 "use -m to share sessions across a hot upgrade" << std::endl;
+    return 1;
+  }
+
   // 初始化数据库连接池
   http::MySqlUtil::init("tcp://127.0.0.1:3306", "root", "root", "Gomoku", 10);
   
   muduo::Logger::setLogLevel(muduo::Logger::INFO);
-  GomokuServer server(port, serverName);
+  // 访问日志由后台线程异步写入，不占用IO线程
+  http::logging::AccessLogger::getInstance().start(accessLogName);
+  http::trace::Tracer::getInstance().setSampleRate(traceSampleRate);
+  // 热升级时新旧进程、共享内存会话的多个进程都要bind同一个端口，所以使用kReusePort；
+  // 其他情况不开启，误启动的第二个实例bind失败，而不是悄悄分走一半连接
+  bool reusePort = upgradable || !sessionShm.empty();
+  muduo::net::TcpServer::Option option = reusePort ? muduo::net::TcpServer::kReusePort
+                                                   : muduo::net::TcpServer::kNoReusePort;
+  GomokuServer server(port, serverName, option, resourceDir, sessionLog, sessionKeyFile, sessionShm);
   server.setThreadNum(4);
+  server.setCpuAffinity(cpuAffinity);
+  if (upgradable)
+  {
+    server.enableHotUpgrade("/tmp/gomoku_" + std::to_string(port) + ".sock", takeOver);
+  }
   server.start();
 }
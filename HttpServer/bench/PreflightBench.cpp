@@ -0,0 +1,130 @@
+// CORS预检请求(OPTIONS)的吞吐测试
+// 对比中间件链用kRespond提前结束请求，和原来before抛出HttpResponse、服务器按值捕获再复制给响应的做法
+// 用法: bench_preflight [每种情况的请求数] [线程数]
+#include "../HTTP/include/middlerWare/MiddlewareChain.h"
+#include "../HTTP/include/middlerWare/cors/CorsMiddleware.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using http::HttpRequest;
+using http::HttpResponse;
+using http::middleware::CorsConfig;
+using http::middleware::CorsMiddleware;
+using http::middleware::Middleware;
+using http::middleware::MiddlewareChain;
+
+namespace
+{
+
+void addHeader(HttpRequest& req, const char* line)
+{
+    const char* end = line + std::strlen(line);
+    req.addHeader(line, std::strchr(line, ':'), end);
+}
+
+HttpRequest makePreflight()
+{
+    HttpRequest req;
+    const char method[] = "OPTIONS";
+    req.setMethod(method, method + std::strlen(method));
+    const char path[] = "/api/login";
+    req.setPath(path, path + std::strlen(path));
+    req.setVersion("HTTP/1.1");
+    addHeader(req, "Origin: http://localhost:3000");
+    addHeader(req, "Access-Control-Request-Method: POST");
+    addHeader(req, "Access-Control-Request-Headers: Content-Type");
+    return req;
+}
+
+// 原来的做法：需要提前结束时中间件抛出写好的响应
+void throwingBefore(CorsMiddleware& cors, HttpRequest& req)
+{
+    HttpResponse resp;
+    if (cors.before(req, resp) == Middleware::kRespond)
+    {
+        throw resp;
+    }
+}
+
+// threads个线程各处理requests个预检请求，返回每秒处理的请求数
+template <typename Op>
+double run(int threads, size_t requests, Op op)
+{
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&]() {
+            HttpRequest req = makePreflight();
+            for (size_t i = 0; i < requests; ++i)
+            {
+                op(req);
+            }
+        });
+    }
+    for (auto& w : workers)
+    {
+        w.join();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return threads * requests / elapsed.count();
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    size_t requests = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+    int threads = argc > 2 ? std::atoi(argv[2]) : 1;
+    if (requests == 0 || threads <= 0)
+    {
+        std::fprintf(stderr, "usage: %s [requests] [threads]\n", argv[0]);
+        return 1;
+    }
+
+    CorsConfig config = CorsConfig::defaultConfig();
+    config.allowedOrigins = {"http://localhost:3000"};
+    auto cors = std::make_shared<CorsMiddleware>(config);
+    MiddlewareChain chain;
+    chain.addMiddleware(cors);
+
+    // 预检请求在before就结束，执行器和handler都不会用到
+    MiddlewareChain::Executor post = [](std::function<void()> step) { step(); };
+    MiddlewareChain::Handler handler = [](const std::function<void()>& done) { done(); };
+
+    double respond = run(threads, requests, [&](HttpRequest& req) {
+        HttpResponse resp;
+        chain.process(req, resp, post, handler, []() {});
+        if (resp.getStatusCode() != HttpResponse::k204NoContent)
+        {
+            std::abort();
+        }
+    });
+    double exception = run(threads, requests, [&](HttpRequest& req) {
+        HttpResponse resp;
+        try
+        {
+            throwingBefore(*cors, req);
+        }
+        catch (HttpResponse res)
+        {
+            resp = res;
+        }
+        if (resp.getStatusCode() != HttpResponse::k204NoContent)
+        {
+            std::abort();
+        }
+    });
+
+    std::printf("requests=%zu threads=%d\n", requests, threads);
+    std::printf("%-12s %16s\n", "mode", "requests/s");
+    std::printf("%-12s %16.0f\n", "kRespond", respond);
+    std::printf("%-12s %16.0f\n", "exception", exception);
+    return 0;
+}
@@ -0,0 +1,138 @@
+// 动态路由匹配的吞吐测试：分别注册10、100、1000条带参数的路由
+// 对比前缀树路由器和原来逐条std::regex_match、匹配后复制请求写入param1..N的做法
+// 用法: bench_router [每种情况运行的秒数]
+#include "../HTTP/include/router/Router.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <regex>
+#include <string>
+#include <utility>
+#include <vector>
+
+using http::HttpRequest;
+using http::HttpResponse;
+using http::router::Router;
+
+namespace
+{
+
+std::string routePattern(size_t i)
+{
+    return "/api/v1/res" + std::to_string(i) + "/:id/items/:item";
+}
+
+std::string requestPath(size_t i)
+{
+    return "/api/v1/res" + std::to_string(i) + "/12345/items/abcdef";
+}
+
+void setPath(HttpRequest& req, const std::string& path)
+{
+    req.setPath(path.data(), path.data() + path.size());
+}
+
+// 在seconds秒内不断执行op，返回每秒完成的次数
+template <typename Op>
+double run(double seconds, Op op)
+{
+    auto start = std::chrono::steady_clock::now();
+    size_t done = 0;
+    std::chrono::duration<double> elapsed(0);
+    while (elapsed.count() < seconds)
+    {
+        for (int i = 0; i < 256; ++i)
+        {
+            op(done++);
+        }
+        elapsed = std::chrono::steady_clock::now() - start;
+    }
+    return done / elapsed.count();
+}
+
+// 原来的动态路由：按注册顺序逐条正则匹配，匹配成功后复制请求再写入参数
+class RegexRouter
+{
+public:
+    void add(const std::string& pattern, Router::HandlerCallback callback)
+    {
+        std::string regex = std::regex_replace(pattern, std::regex(":[^/]+"), "([^/]+)");
+        routes_.emplace_back(std::regex("^" + regex + "$"), std::move(callback));
+    }
+
+    bool route(const HttpRequest& req, HttpResponse* resp)
+    {
+        std::string path = req.path();
+        std::smatch match;
+        for (const auto& route : routes_)
+        {
+            if (std::regex_match(path, match, route.first))
+            {
+                HttpRequest newReq(req);
+                for (size_t i = 1; i < match.size(); ++i)
+                {
+                    newReq.setPathParameters("param" + std::to_string(i), match[i].str());
+                }
+                route.second(newReq, resp);
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    std::vector<std::pair<std::regex, Router::HandlerCallback>> routes_;
+};
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    double seconds = argc > 1 ? std::atof(argv[1]) : 1.0;
+    if (seconds <= 0)
+    {
+        std::fprintf(stderr, "usage: %s [seconds per case]\n", argv[0]);
+        return 1;
+    }
+
+    auto callback = [](const HttpRequest&, HttpResponse*) {};
+    auto done = []() {};
+
+    std::printf("%8s %16s %16s\n", "routes", "radix ops/s", "regex ops/s");
+    for (size_t routeCount : {10, 100, 1000})
+    {
+        Router router;
+        RegexRouter regexRouter;
+        std::vector<std::string> paths;
+        for (size_t i = 0; i < routeCount; ++i)
+        {
+            router.addDynamicCallback(HttpRequest::kGet, routePattern(i), callback);
+            regexRouter.add(routePattern(i), callback);
+            paths.push_back(requestPath(i));
+        }
+
+        HttpRequest req;
+        const char get[] = "GET";
+        req.setMethod(get, get + 3);
+        HttpResponse resp;
+        setPath(req, paths.back());
+        if (!router.route(req, &resp, done) || !regexRouter.route(req, &resp))
+        {
+            std::fprintf(stderr, "route %s did not match\n", paths.back().c_str());
+            return 1;
+        }
+
+        // 依次请求每一条路由，正则路由器的耗时和路由的位置有关，轮流请求得到平均值
+        double radix = run(seconds, [&](size_t n) {
+            setPath(req, paths[n % routeCount]);
+            router.route(req, &resp, done);
+        });
+        double regex = run(seconds, [&](size_t n) {
+            setPath(req, paths[n % routeCount]);
+            regexRouter.route(req, &resp);
+        });
+        std::printf("%8zu %16.0f %16.0f\n", routeCount, radix, regex);
+    }
+    return 0;
+}
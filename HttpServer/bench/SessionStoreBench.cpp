@@ -0,0 +1,113 @@
+// 内存会话存储的多线程吞吐测试：线程数增加时load(查找)和save(写入)每秒能完成多少次
+// 用法: bench_session_store [会话数] [每个线程的操作数]
+#include "../HTTP/include/session/SessionStorage.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using http::session::MemorySessionStorage;
+using http::session::Session;
+
+namespace
+{
+
+// 和SessionManager生成的id格式一致：32个十六进制字符
+std::string makeSessionId(std::mt19937_64& rng)
+{
+    static const char kHex[] = "0123456789abcdef";
+    std::string id(32, '0');
+    for (char& c : id)
+    {
+        c = kHex[rng() & 0xf];
+    }
+    return id;
+}
+
+// threads个线程同时对随机的会话(下标)执行op，返回每秒完成的操作数
+template <typename Op>
+double run(int threads, size_t opsPerThread, size_t sessionCount, Op op)
+{
+    std::atomic<int> ready(0);
+    std::atomic<bool> go(false);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&, t]() {
+            std::mt19937_64 rng(t + 1);
+            ++ready;
+            while (!go.load(std::memory_order_acquire))
+            {
+                std::this_thread::yield();
+            }
+            for (size_t i = 0; i < opsPerThread; ++i)
+            {
+                op(rng() % sessionCount);
+            }
+        });
+    }
+    while (ready.load() < threads)
+    {
+        std::this_thread::yield();
+    }
+    auto start = std::chrono::steady_clock::now();
+    go.store(true, std::memory_order_release);
+    for (auto& w : workers)
+    {
+        w.join();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return threads * opsPerThread / elapsed.count();
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    size_t sessionCount = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+    size_t opsPerThread = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 1000000;
+    if (sessionCount == 0 || opsPerThread == 0)
+    {
+        std::fprintf(stderr, "usage: %s [sessions] [ops per thread]\n", argv[0]);
+        return 1;
+    }
+
+    MemorySessionStorage storage;
+    std::vector<std::string> ids;
+    std::vector<std::shared_ptr<Session>> sessions;
+    std::mt19937_64 rng(42);
+    for (size_t i = 0; i < sessionCount; ++i)
+    {
+        ids.push_back(makeSessionId(rng));
+        auto session = std::make_shared<Session>(ids.back(), nullptr);
+        session->setValue("userId", std::to_string(i));
+        storage.save(session);
+        sessions.push_back(session);
+    }
+
+    int maxThreads = std::max(8u, std::thread::hardware_concurrency());
+    std::printf("sessions=%zu ops/thread=%zu\n", sessionCount, opsPerThread);
+    std::printf("%8s %16s %16s\n", "threads", "load ops/s", "save ops/s");
+    for (int threads = 1; threads <= maxThreads; threads *= 2)
+    {
+        double loads = run(threads, opsPerThread, sessionCount, [&](size_t i) {
+            if (!storage.load(ids[i]))
+            {
+                std::abort();
+            }
+        });
+        // 写入已存在的会话，和请求结束时提交修改过的会话一样
+        double saves = run(threads, opsPerThread, sessionCount, [&](size_t i) {
+            storage.save(sessions[i]);
+        });
+        std::printf("%8d %16.0f %16.0f\n", threads, loads, saves);
+    }
+    return 0;
+}
@@ -0,0 +1,165 @@
+# 把资源目录下的文件生成一个C++源文件，编译进程序，运行时不需要读文件
+# 每个文件生成预先拼好响应头的constexpr字节数组（原始内容、gzip压缩的内容、304的响应头），
+# 格式和StaticFileServer::buildEntry一致，ETag取内容SHA1的前16位，gzip版本的ETag再加上"-gz"
+#
+# 用法：cmake -DRESOURCE_DIR=<目录> -DOUTPUT=<生成的cpp> -DSYMBOL=<表的变量名> [-DGZIP=<gzip程序>]
+#            -P EmbedResources.cmake
+# 生成的cpp中定义 extern const http::file::EmbeddedResourceTable <SYMBOL>
+
+if(NOT RESOURCE_DIR OR NOT OUTPUT OR NOT SYMBOL)
+    message(FATAL_ERROR "EmbedResources.cmake: RESOURCE_DIR, OUTPUT and SYMBOL are required")
+endif()
+
+# 扩展名 -> Content-Type，以及是否值得压缩
+function(resource_mime name out_type out_compressible)
+    get_filename_component(ext "${name}" EXT)
+    string(TOLOWER "${ext}" ext)
+    set(compressible TRUE)
+    if(ext STREQUAL ".html" OR ext STREQUAL ".htm")
+        set(type "text/html; charset=utf-8")
+    elseif(ext STREQUAL ".css")
+        set(type "text/css; charset=utf-8")
+    elseif(ext STREQUAL ".js")
+        set(type "application/javascript; charset=utf-8")
+    elseif(ext STREQUAL ".json")
+        set(type "application/json")
+    elseif(ext STREQUAL ".txt")
+        set(type "text/plain; charset=utf-8")
+    elseif(ext STREQUAL ".svg")
+        set(type "image/svg+xml")
+    elseif(ext STREQUAL ".xml")
+        set(type "application/xml")
+    else()
+        set(compressible FALSE)
+        if(ext STREQUAL ".png")
+            set(type "image/png")
+        elseif(ext STREQUAL ".jpg" OR ext STREQUAL ".jpeg")
+            set(type "image/jpeg")
+        elseif(ext STREQUAL ".gif")
+            set(type "image/gif")
+        elseif(ext STREQUAL ".ico")
+            set(type "image/x-icon")
+        elseif(ext STREQUAL ".webp")
+            set(type "image/webp")
+        elseif(ext STREQUAL ".woff")
+            set(type "font/woff")
+        elseif(ext STREQUAL ".woff2")
+            set(type "font/woff2")
+        else()
+            set(type "application/octet-stream")
+        endif()
+    endif()
+    set(${out_type} "${type}" PARENT_SCOPE)
+    set(${out_compressible} ${compressible} PARENT_SCOPE)
+endfunction()
+
+# 每行16个字节
+set(LINE_PATTERN "")
+foreach(i RANGE 1 16)
+    string(APPEND LINE_PATTERN "[0-9a-f][0-9a-f]")
+endforeach()
+
+# 十六进制字符串 -> C++数组定义
+function(hex_array name hex out)
+    string(REGEX REPLACE "(${LINE_PATTERN})" "\\1\n" hex "${hex}")
+    string(REGEX REPLACE "([0-9a-f][0-9a-f])" "'\\\\x\\1'," hex "${hex}")
+    string(REGEX REPLACE "\n$" "" hex "${hex}")
+    string(REPLACE "\n" "\n    " hex "${hex}")
+    set(${out} "constexpr char ${name}[] = {\n    ${hex}\n};\n" PARENT_SCOPE)
+endfunction()
+
+# 文本 -> 十六进制字符串
+set(TEXT_TMP "${OUTPUT}.text.tmp")
+function(text_hex text out)
+    file(WRITE "${TEXT_TMP}" "${text}")
+    file(READ "${TEXT_TMP}" hex HEX)
+    set(${out} "${hex}" PARENT_SCOPE)
+endfunction()
+
+file(GLOB_RECURSE FILES RELATIVE "${RESOURCE_DIR}" "${RESOURCE_DIR}/*")
+list(SORT FILES)
+
+set(ARRAYS "")
+set(ENTRIES "")
+set(INDEX 0)
+set(GZIP_TMP "${OUTPUT}.gz.tmp")
+foreach(name ${FILES})
+    set(path "${RESOURCE_DIR}/${name}")
+    resource_mime("${name}" type compressible)
+    file(SHA1 "${path}" sha1)
+    string(SUBSTRING "${sha1}" 0 16 hash)
+    set(etag "\"${hash}\"")
+    set(gzipEtag "\"${hash}-gz\"")
+
+    file(READ "${path}" body HEX)
+    string(LENGTH "${body}" length)
+    math(EXPR length "${length} / 2")
+
+    # 和StaticFileServer::buildEntry生成的响应头一致
+    set(cacheControl "Cache-Control: no-cache\r\n")
+    if(compressible)
+        string(APPEND cacheControl "Vary: Accept-Encoding\r\n")
+    endif()
+
+    text_hex("Content-Type: ${type}\r\nETag: ${etag}\r\n${cacheControl}Content-Length: ${length}\r\n\r\n" head)
+    hex_array("kPlain${INDEX}" "${head}${body}" array)
+    string(APPEND ARRAYS "${array}")
+    set(gzipView "{}")
+    set(gzipEtagView "{}")
+    set(gzipNotModifiedView "{}")
+
+    if(compressible AND GZIP)
+        # -n 不写入文件名和时间，内容不变时生成的结果也不变
+        execute_process(COMMAND "${GZIP}" -9 -n -c "${path}"
+                        OUTPUT_FILE "${GZIP_TMP}" RESULT_VARIABLE rc)
+        if(rc EQUAL 0)
+            file(READ "${GZIP_TMP}" gzipBody HEX)
+            string(LENGTH "${gzipBody}" gzipLength)
+            math(EXPR gzipLength "${gzipLength} / 2")
+            if(gzipLength LESS length)
+                set(gzipHead "Content-Type: ${type}\r\nETag: ${gzipEtag}\r\n${cacheControl}")
+                string(APPEND gzipHead "Content-Encoding: gzip\r\nContent-Length: ${gzipLength}\r\n\r\n")
+                text_hex("${gzipHead}" head)
+                hex_array("kGzip${INDEX}" "${head}${gzipBody}" array)
+                string(APPEND ARRAYS "${array}")
+                set(gzipView "{kGzip${INDEX}, sizeof(kGzip${INDEX})}")
+                text_hex("ETag: ${gzipEtag}\r\nCache-Control: no-cache\r\n\r\n" head)
+                hex_array("kGzipNotModified${INDEX}" "${head}" array)
+                string(APPEND ARRAYS "${array}")
+                set(gzipNotModifiedView "{kGzipNotModified${INDEX}, sizeof(kGzipNotModified${INDEX})}")
+                string(REPLACE "\"" "\\\"" gzipEtagLiteral "${gzipEtag}")
+                set(gzipEtagView "\"${gzipEtagLiteral}\"")
+            endif()
+        endif()
+    endif()
+
+    text_hex("ETag: ${etag}\r\nCache-Control: no-cache\r\n\r\n" head)
+    hex_array("kNotModified${INDEX}" "${head}" array)
+    string(APPEND ARRAYS "${array}\n")
+
+    string(REPLACE "\"" "\\\"" etagLiteral "${etag}")
+    string(APPEND ENTRIES "    {\"${name}\", \"${type}\", \"${etagLiteral}\",\n"
+                          "     {kPlain${INDEX}, sizeof(kPlain${INDEX})}, ${gzipView},\n"
+                          "     {kNotModified${INDEX}, sizeof(kNotModified${INDEX})},\n"
+                          "     ${gzipEtagView}, ${gzipNotModifiedView}},\n")
+    math(EXPR INDEX "${INDEX} + 1")
+endforeach()
+file(REMOVE "${TEXT_TMP}" "${GZIP_TMP}")
+
+list(LENGTH FILES COUNT)
+if(COUNT EQUAL 0)
+    message(FATAL_ERROR "EmbedResources.cmake: no files under ${RESOURCE_DIR}")
+endif()
+
+file(WRITE "${OUTPUT}"
+"// 由cmake/EmbedResources.cmake根据${RESOURCE_DIR}生成，不要手动修改
+#include \"file/EmbeddedResource.h\"
+
+namespace
+{
+${ARRAYS}constexpr http::file::EmbeddedResource kResources[] = {
+${ENTRIES}};
+} // namespace
+
+extern const http::file::EmbeddedResourceTable ${SYMBOL} = {kResources, ${COUNT}};
+")